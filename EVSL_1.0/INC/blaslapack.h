@@ -11,9 +11,14 @@
 #define DGEMV    dgemv_
 #define DGEMM    dgemm_
 #define DAXPY    daxpy_
+#define DTRSM    dtrsm_
+#define DTRMM    dtrmm_
 #define DSTEV    dstev_
 #define DSYEV    dsyev_
 #define DSTEMR   dstemr_
+#define DSYTRD   dsytrd_
+#define DORGTR   dorgtr_
+#define DPOTRF   dpotrf_
 #define DHSEQR   dhseqr_
 #define ZGESV    zgesv_
 
@@ -27,12 +32,21 @@ double DASUM(int *n,double *x,int *incx);
 double DDOT(int *n,double *x,int *incx,double *y,int *incy);
 double DNRM2(int *n,double *x,int *incx);
 void DGEMM(char *transa,char *transb,int *m,int *n,int *k,double *alpha,double *a,int *lda,double *b,int *ldb,double *beta,double *c,int *ldc);
+void DTRSM(char *side, char *uplo, char *transa, char *diag, int *m, int *n, double *alpha, 
+           double *A, int *lda, double *B, int *ldb);
+void DTRMM(char *side, char *uplo, char *transa, char *diag, int *m, int *n, double *alpha, 
+           double *A, int *lda, double *B, int *ldb);
 void DGEMV(char *trans, int *m, int *n, double *alpha, double *a, int *lda, double *x, int *incx, double *beta, double *y, int *incy);
 void DSTEV(char *jobz, int *n, double *diagonal, double *subdiagonal, double *V, int *ldz, double *work, int *info);
 void DSYEV(char* jobz,char* uplo,int* n,double* fa,int* lda,double* w, double* work,int* lwork,int* info);
 void DSTEMR(char *jobz, char *range, int *n, double *D, double *E, double *VL, double *VU, int *IL, int *IU, 
 	    int *M, double *W, double *Z, int *LDZ, int *NZC, int *ISUPPZ, logical *TRYRAC, double *WORK, 
 	    int *LWORK, int *IWORK, int *LIWORK, int *INFO);
+void DSYTRD(char *uplo, int *n, double *A, int *lda, double *D, double *E, double *tau, 
+            double *work, int *lwork, int *info);
+void DORGTR(char *uplo, int *n, double *A, int *lda, double *tau, double *work, int *lwork, 
+            int *info);
+void DPOTRF(char *uplo, int *n, double *A, int *lda, int *info);
 void DHSEQR(char* jobz,char* compz,int* n,int* ilo,int* ihi,double* h,int* ldh,double* wr,double* wi,
 	    double* z,int* ldz,double* work, int* lwork,int* info);
 void ZGESV(int *n, int *nrow, complex double * A, int* m, int* ipiv, complex double *rhs, int* k, int* INFO);
@@ -31,4 +31,8 @@
 /* max number of Gram–Schmidt process in orthogonalization */
 #define NGS_MAX 2
 
+/* min average number of rows per level for the level-scheduled triangular
+ * solves to run in parallel */
+#define TRI_SCHED_MINW 64
+
 #endif
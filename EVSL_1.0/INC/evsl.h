@@ -25,6 +25,10 @@ void set_pol_def(polparams *pol);
 int find_pol(double *intv, polparams *pol);
 //
 void free_pol(polparams *pol);
+/* cache of the filters of find_pol [file: where it is saved, or NULL] */
+void SetPolCache(const char *file);
+/* save [if a file is set] and free the cache of the filters, turn it off */
+void FreePolCache();
 
 /*- - - - - - - - - chebsi.c */
 int ChebSI(csrMat *A, int nev, double *intv, int maxit, double tol, 
@@ -44,14 +48,34 @@ int find_ratf(double *intv, ratparams *rat);
 //
 int set_ratf_solfunc(ratparams *rat, csrMat *A, linSolFunc *funcs, void **data);
 //
+int set_ratf_solfunc_block(ratparams *rat, linSolFuncBlock *funcs);
+//
+int set_ratf_solfunc_z(ratparams *rat, linSolFuncZ *funcs);
+
+/*- - - - - - - - - cocg.c */
+//
+int set_ratf_solfunc_iter(ratparams *rat, csrMat *A, linSolFunc *prec,
+                          void **precdata);
+//
 void free_rat(ratparams *rat);
 
+/*- - - - - - - - - zldl.c */
+/* set the cache of the LDL^T factors of the poles [budget in bytes] */
+void SetFactCache(size_t budget, const char *dir);
+/* free the cache of the LDL^T factors and turn it off */
+void FreeFactCache();
+
 /*- - - - - - - - - ratlanNr.c */
 //
 int RatLanNr(csrMat *A, double *intv, ratparams *, int maxit, double tol, 
              double *vinit, int *nevOut, double **lamo, double **Wo, 
              double **reso, FILE *fstats);
 
+/*- - - - - - - - - ratlanNrBlock.c */
+//
+int RatLanNrBlock(csrMat *A, double *intv, ratparams *rat, int bs, int maxit,
+                  double tol, double *vinit, int *nevOut, double **lamo,
+                  double **Wo, double **reso, FILE *fstats);
 
 /*- - - - - - - - - ratlanTr.c */
 //
@@ -72,12 +96,26 @@ int matvec_csr(csrMat *A, double *x, double *y);
 /*- - - - - - - - - evsl.c */
 /* set an external matvec function */
 void SetMatvecFunc(int n, MVFunc func, void *data);
+/* set an external matvec function fused with the filter steps */
+void SetMatvecChebFunc(MVChebFunc func);
 /* unset an external matvec function */
 void UnsetMatvecFunc();
 /* set matrix B */
 int SetRhsMatrix(csrMat *B);
+/* set matrix B, factorization free [polynomial in B of accuracy tol] */
+int SetRhsMatrixPol(csrMat *B, double tol);
 /* unset matrix B */
 void UnsetRhsMatrix();
+/* set the block size of s-step Lanczos [s <= 1: standard Lanczos] */
+void SetLanSstep(int s);
+/* set if the reductions of a Lanczos step are merged [ChebLanTr] */
+void SetLanPipelined(int pipe);
+/* set if the filter is applied by the Clenshaw recurrence */
+void SetChebClenshaw(int clen);
+/* set the temporal blocking of the filter [0: auto, < 0: off, > 0: steps].
+ * s > 0 forces s steps per block for any banded matrix, whether or not a
+ * block of rows fits in cache */
+void SetChebTBlock(int s);
 /* start EVSL */
 void EVSLStart();
 /* finalize EVSL */
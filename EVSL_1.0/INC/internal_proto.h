@@ -12,10 +12,13 @@
 //
 int chebxCoefd(int m, double gam, int damping, double *mu);
 //
-int dampcf(int m, int damping, double *jac);
+int dampcf(int m, int damping, double lev, double *jac);
+int dampcf_dolph(int m, double lev, double *jac);
 //
 int chebxPltd(int m, double *mu, int n, double *xi, double *yi);
 //
+int chebxRange(int m, double *mu, double *lo, double *hi);
+//
 int ChebAv(csrMat *A, polparams *pol, double *v, double *y, double *w);
 
 int ChebAv0(csrMat *A, polparams *pol, double *v, double *y, double *w);
@@ -43,6 +46,19 @@ int SymmTridEigS(double *eigVal, double *eigVec, int n, double vl, double vu, in
 //
 void SymEigenSolver(int n, double *A, int lda, double *Q, int ldq, double *lam);
 //
+void alloc_treig(int ldt, trEigWork *ws);
+//
+void free_treig(trEigWork *ws);
+//
+int ArrowTridEig(int k, int trlen, double *T, int ldt, double vl, int *nevO, 
+                 double *lam, double *Q, int ldq, trEigWork *ws);
+//
+int ArrowTridEigBot(int k, int trlen, double *T, int ldt, double *lam, 
+                    double *zb, trEigWork *ws);
+//
+void RitzVecsInPlace(int n, int k, int m, double *V, double *Q, int ldq, 
+                     double *work, int lwork);
+//
 void CGS_DGKS(int n, int k, int i_max, double *Q, double *v, double *nrmv, double *w);
 //
 void orth(double *V, int n, int k, double *Vo, double *work);
@@ -63,7 +79,10 @@ void weights(int n, complex double* zk, int* pow, double lambda, complex double*
 int scaleweigthts(int n, double a, double b, complex double *zk, int* pow, complex double* omegaM);
 
 /*- - - - - - - - - ratlanNr.c */
-void RatFiltApply(int n, ratparams *rat, double *b, double *x, double *w3);
+int RatFiltNthreads(ratparams *rat);
+void RatFiltApply(int n, ratparams *rat, double *b, double *x, double *w);
+void RatFiltApplyBlock(int n, int p, ratparams *rat, double *B, double *X,
+                       double *w);
 
 /*- - - - - - - - - spmat.c */
 // matvec: y = A * x
@@ -76,6 +95,34 @@ void sortrow(csrMat *A);
 int check_full_diag(char type, csrMat *A);
 //
 int tri_sol_upper(char trans, csrMat *R, double *b, double *x);
+//
+void tri_sched_setup(csrMat *R, triSched *T);
+//
+void tri_sol_upper_sched(char trans, csrMat *R, triSched *T, int *p,
+                         double *b, double *x);
+//
+//
+void tri_genmv_sched(csrMat *R, triSched *T, int *p, csrMat *A,
+                     double *x, double *y, double *w);
+//
+void tri_genmv_cheb_sched(csrMat *R, triSched *T, int *p, csrMat *A,
+                          double alpha, double cc, double beta, double *vk,
+                          double *vkm1, double *vkp1, double *y, double *w);
+void free_tri_sched(triSched *T);
+
+/*- - - - - - - - - cocg.c */
+void ratf_set_soltol(ratparams *rat, double tol);
+int ratf_iter_count(ratparams *rat);
+void free_rat_iter_sol(ratparams *rat);
+void ratf_multishift_apply(int n, ratparams *rat, double *b, double *x);
+
+/*- - - - - - - - - zldl.c */
+int set_ratf_solfunc_ldl(csrMat *A, ratparams *rat);
+void free_rat_ldl_sol(ratparams *rat);
+
+/*- - - - - - - - - bpolsol.c */
+int set_pol_LBdata(csrMat *B, double tol);
+void free_pol_LBdata();
 
 /*- - - - - - - - - suitesparse.c */
 int set_ratf_solfunc_default(csrMat *A, ratparams *rat);
@@ -1,6 +1,7 @@
 #ifndef STRUCT_H
 #define STRUCT_H
 
+#include <stddef.h>
 #include <complex.h>
 
 /*- - - - - - - - sparse matrix formats */
@@ -29,7 +30,9 @@ typedef struct _polparams {
   // by set_pol_par
   int max_deg;        // max allowed degree
   int min_deg ;       // min allowed degree
-  int damping;        // 0 = no damping, 1 = Jackson, 2 = Lanczos
+  int damping;        // 0 = no damping, 1 = Jackson, 2 = Lanczos,
+                      // 3 = Dolph-Chebyshev [minimax]
+  double sidelobe;    // side-lobe level of the Dolph-Chebyshev damping
   double thresh_ext;  // threshold for accepting polynom. for end intervals 
   double thresh_int;  // threshold for interior intervals 
   // The following are output - i.e., set by set_pol:
@@ -55,6 +58,20 @@ typedef struct _polparams {
  */
 typedef void (*linSolFunc)(int n, double *br, double *bz, double *xr, double *xz, void *data);
 
+/* linear solver function prototype with multiple right-hand sides:
+ * [complex version] same as linSolFunc, but br, bz, xr, xz are n x nrhs
+ * matrices (column major, leading dimension n) and the nrhs systems
+ * are solved at once
+ */
+typedef void (*linSolFuncBlock)(int n, int nrhs, double *br, double *bz,
+                                double *xr, double *xz, void *data);
+
+/* linear solver function prototype with interleaved complex vectors:
+ * same as linSolFunc, but b and x are complex vectors of length n
+ */
+typedef void (*linSolFuncZ)(int n, complex double *b, complex double *x,
+                            void *data);
+
 /* function pointer to apply the following operations with LB
  *   y = LB  \ x 
  *   y = LB' \ x
@@ -63,9 +80,42 @@ typedef void (*linSolFunc)(int n, double *br, double *bz, double *xr, double *xz
  */
 typedef void (*LBFunc)(double *x, double *y, void *data);
 
+/* function pointer of a fused generalized matvec with a CSR matrix A,
+ *   y = LB \ A / LB' x
+ * w: work array of size n, given by the caller [so that the data can be
+ * shared by concurrent calls]
+ */
+typedef void (*LBGenFunc)(csrMat *A, double *x, double *y, double *w,
+                          void *data);
+
+/* function pointer of one step of the Chebyshev recurrence of the filter
+ * [ChebAv] with a CSR matrix A, in the same pass as the matvec
+ *   vkp1 = alpha * (LB \ A / LB' vk - cc * vk) - vkm1,  y = y + beta * vkp1
+ * vkm1 can be overwritten. w: work array of size n [as LBGenFunc]
+ */
+typedef void (*LBChebFunc)(csrMat *A, double alpha, double cc, double beta,
+                           double *vk, double *vkm1, double *vkp1, double *y,
+                           double *w, void *data);
+
 /* matvec function prototype */
 typedef void (*MVFunc)(double *x, double *y, void *data);
 
+/* [optional] matvec function fused with one step of the Chebyshev
+ * recurrence of the filter [ChebAv]
+ *   vkp1 = alpha * (A * vk - cc * vk) - vkm1,  y = y + beta * vkp1
+ * vkm1 can be overwritten */
+typedef void (*MVChebFunc)(double alpha, double cc, double beta, double *vk,
+                           double *vkm1, double *vkp1, double *y, void *data);
+
+/* solvers of the shifted systems of the rational filter, the values of
+ * ratparams.defsolver [requested] and ratparams.use_default_solver [in
+ * use]. The iterative solvers come last */
+#define RATF_SOLVER_USER    0 // user's solvers [set_ratf_solfunc]
+#define RATF_SOLVER_UMFPACK 1 // UMFPACK LU [with SuiteSparse]
+#define RATF_SOLVER_LDL     2 // built-in complex symmetric LDL^T [zldl.c]
+#define RATF_SOLVER_COCG    3 // iterative COCG [cocg.c]
+#define RATF_SOLVER_MSHIFT  4 // multi-shift COCG [poles of multiplicity 1]
+
 typedef struct _ratparams {
   /* parameters for rational filter */
   int num;            // number of the poles
@@ -86,34 +136,132 @@ typedef struct _ratparams {
   /* function and associated data to solve shifted linear system (complex) 
    * with A-\sigma B 
    * arrays of function pointers and (void*), of length `num' */
-  int use_default_solver;
+  int defsolver;      // default solver: RATF_SOLVER_UMFPACK, _LDL, _COCG
+                      // or _MSHIFT [see above]
+  int realform;       // UMFPACK: factor the real 2n x 2n equivalent form
+                      // of A - z_k I instead of the complex matrix
+  double soltol;      // rel. tolerance of the iterative solver [0: set from
+                      // the tolerance of the Lanczos process]
+  size_t membudget;   // memory budget in bytes for the factors of the poles
+                      // [0: no limit], see set_ratf_solfunc_ldl
+  /* pole selection in find_ratf [optpoles = 1]: num and pw of least cost
+   * such that |r(x)| <= gapratio * bar at a distance >= gap (relative to
+   * the half-width of [aa, bb]) outside [aa, bb]. The cost is
+   * num * costfact + napply * num * pw solves */
+  int optpoles;       // 1: choose num and pw, 0: use the given ones
+  double gap;         // relative gap where the filter is checked
+  double gapratio;    // target value of |r| / bar beyond the gap
+  double costfact;    // cost of one factorization, in units of one solve
+  int napply;         // expected number of applications of the filter
+  /* memory plan chosen by set_ratf_solfunc [output] */
+  int memplan;        // 0: all the factors in core, 1: some out of core,
+                      // 2: iterative solver (COCG) instead of the factors
+  int nincore;        // number of poles with their factors in core
+  size_t factbytes;   // estimated memory of the factors of one pole
+  int use_default_solver; // solver in use: RATF_SOLVER_*
+  /* thread safety of the solvers: the poles are processed in parallel
+   * [OpenMP, RatFiltApply and RatFiltApplyBlock], so the solvers of
+   * different poles may be called at the same time, by different threads,
+   * but the solvers of one pole are never called concurrently. A solver
+   * may use the work space in its own solshiftdata[k], but any data shared
+   * by several poles must be read-only or protected [e.g., the page buffer
+   * of the out-of-core LDL^T factors, used in a critical section] */
   linSolFunc *solshift;
+  /* optional multiple right-hand side solvers [NULL if not available],
+   * which use the same data as solshift */
+  linSolFuncBlock *solshiftblk;
+  /* optional solvers with interleaved complex vectors [NULL if not
+   * available], which use the same data as solshift */
+  linSolFuncZ *solshiftz;
   void **solshiftdata;
 } ratparams;
 
 
+/* work space for the eigen-decomposition of the projected matrix T in the
+ * thick restart Lanczos methods. After a restart, T is diagonal + one
+ * arrowhead row/column in its leading (trlen+1) block and tridiagonal
+ * after that. The arrowhead block is reduced to tridiagonal form once per
+ * restart and the resulting tridiagonal matrix is solved by DSTEMR */
+typedef struct _trEigWork {
+  int ldt;            // max dimension of T [lanm+1]
+  int trlen;          // size of the arrowhead part of T
+  int reduced;        // if the arrowhead block has been reduced since restart
+  double *Qa;         // (trlen+1) x (trlen+1) matrix that reduces the arrowhead
+  double *da, *ea;    // diag/sub-diag of the reduced arrowhead block
+  double *d, *e;      // diag/sub-diag passed to DSTEMR [destroyed]
+  double *Z;          // work array for the top rows of the eigenvectors
+  double *work;       // real work array of size lwork
+  int lwork;
+  int *iwork;         // int work array of size liwork
+  int liwork;
+  int *isuppz;        // support of the eigenvectors [not used]
+} trEigWork;
+
+/* level schedule of the triangular solves with an upper triangular R
+ * (CSR, diagonal first in each row) and with R'. The rows of a level only
+ * depend on the rows of the previous levels, so they are solved in
+ * parallel */
+typedef struct _triSched {
+  csrMat Rt;          // R' in CSR (lower triangular, diagonal last)
+  int nlev;           // number of levels [same for R and R']
+  int *levptrU, *levU;// rows of R by level: levU[levptrU[l]:levptrU[l+1]-1]
+  int *levptrL, *levL;// rows of R' by level
+  int par;            // if the levels are wide enough to solve in parallel
+} triSched;
+
 typedef struct _externalMatvec {
   int n;
   MVFunc func;
+  MVChebFunc chebfunc;  // [optional] fused with the filter, same data
   void *data;
 } externalMatvec;
 
+/* plan of the temporal blocking of ChebAv for one matrix and degree
+ * [cached by ChebAv, so that the bandwidth of A is not scanned at each
+ * call]. The pattern of A is identified by A, ja, nrows and nnz */
+typedef struct _chebTBPlan {
+  csrMat *A;          // [key] the matrix
+  int *ja, n, nnz;    // [key] its pattern
+  int deg, mode;      // [key] degree of the filter, and chebtb
+  int s, bw;          // steps per block [0: not used], bandwidth of A
+} chebTBPlan;
+
 /* wrapper of global variables */
 typedef struct _evsldata {
   /* external matvec routine and the associated data for A */
   externalMatvec Amatvec;
   /* if right-hand matrix B is set */
   int hasB;
-  /* if B is factored by the default solver */
+  /* if B is handled by a built-in solver:
+   * 1: Cholesky factor [CHOLMOD], 2: polynomial in B [factorization free] */
   int isDefaultLB;
   /* functions and the data to perform y=LB * x, y=LB' * x,  y=LB \ x, and y=LB' \ x */
   LBFunc LB_mult, LBT_mult, LB_solv, LBT_solv;
+  /* [optional] fused y = LB \ A / LB' x, used when A is a CSR matrix.
+   * It takes the place of the three passes below */
+  LBGenFunc LB_genmv;
+  /* [optional] the same, fused with one step of the filter [ChebAv] */
+  LBChebFunc LB_chebstep;
   void *LB_func_data;
   /* work space for performing matvec_gen, y = L \ A / L' x 
    *      y = L' \ x;
    *   work = A  * y 
-   *      y = L  \ work */
+   *      y = L  \ work
+   * [called in a parallel region, matvec_genev uses its own instead] */
   double *matvec_gen_work;
+  /* block size of the s-step filtered Lanczos [ChebLanTr].
+   * s <= 1 means the standard (one step at a time) process */
+  int sstep;
+  /* if the reductions of a filtered Lanczos step are merged into one
+   * [ChebLanTr, no overlap with the filter] */
+  int pipelined;
+  /* if the filter is applied by the Clenshaw recurrence [ChebAv] */
+  int chebclen;
+  /* temporal blocking of the filter for banded A [ChebAv]:
+   * 0: automatic, < 0: never, > 0: number of steps per block */
+  int chebtb;
+  /* the last plan of the temporal blocking */
+  chebTBPlan chebtbplan;
 } evslData;
 
 /* global variable: evslData */
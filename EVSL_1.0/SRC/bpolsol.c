@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "def.h"
+#include "blaslapack.h"
+#include "struct.h"
+#include "internal_proto.h"
+
+/**
+ * @file bpolsol.c
+ * @brief Factorization-free B for the generalized problem A x = lambda B x,
+ * with a polynomial approximation of B^{-1/2}
+ *
+ * With D = diag(B) and the Jacobi scaled C = D^{-1/2} B D^{-1/2}, we have
+ * B = L L' with L = D^{1/2} C^{1/2}. C^{-1/2} is approximated by a
+ * Chebyshev expansion p(C) on an interval [c0, c1] containing the spectrum
+ * of C, which gives
+ *      L \ x  = p(C) D^{-1/2} x,    L' \ x = D^{-1/2} p(C) x,
+ * and the symmetric operator L \ A / L' of the standard path. So, all the
+ * polynomial filtered solvers and the back-transformation of the
+ * eigenvectors are used as they are, with matvecs with B only.
+ * The degree of p is small when C is well conditioned, e.g., for the mass
+ * matrices of finite elements, for which cond(C) is bounded independently
+ * of the mesh size
+ */
+
+/* max degree of the Chebyshev expansion of t^{-1/2} */
+#define BPOL_MAXDEG 200
+/* number of Chebyshev-Gauss points for the coefficients */
+#define BPOL_NPTS (4*BPOL_MAXDEG)
+/* number of Lanczos steps for the spectrum bounds of C */
+#define BPOL_LANSTEPS 40
+/* relative safety margin added to the spectrum bounds of C */
+#define BPOL_MARGIN 0.01
+
+/* data of the polynomial B solver */
+typedef struct _bpolData {
+  int n;
+  csrMat C;       // Jacobi scaled B, D^{-1/2} B D^{-1/2}
+  double *dsqi;   // D^{-1/2}
+  double c0, c1;  // interval of the expansion [c0, c1]
+  double cc, hh;  // center and half width of [c0, c1]
+  int deg;        // degree of the expansion
+  double *mu;     // Chebyshev coefficients, of size deg+1
+  double *w;      // work array of size 3*n
+} bpolData;
+
+/**
+ * @brief Spectrum bounds of C by a Lanczos run without reorthogonalization
+ * [only the extreme Ritz values are needed, which are not affected by the
+ * loss of orthogonality]. The bounds are 'safe' as in LanBounds
+ */
+static int bpol_bounds(csrMat *C, double *cmin, double *cmax,
+                       double *tmin) {
+  int n = C->nrows, one = 1, j, msteps = min(BPOL_LANSTEPS, n);
+  double *alp, *bet, *v, *vold, *w, *tmp, t, *S, *ritz;
+  Malloc(alp, msteps, double);
+  Malloc(bet, msteps, double);
+  Malloc(v, n, double);
+  Calloc(vold, n, double);
+  Malloc(w, n, double);
+  rand_double(n, v);
+  t = 1.0 / DNRM2(&n, v, &one);
+  DSCAL(&n, &t, v, &one);
+  double wn = 0.0;
+  for (j=0; j<msteps; j++) {
+    /* w = C*v - bet * vold */
+    matvec_csr(C, v, w);
+    if (j) {
+      t = -bet[j-1];
+      DAXPY(&n, &t, vold, &one, w, &one);
+    }
+    alp[j] = DDOT(&n, w, &one, v, &one);
+    wn += alp[j] * alp[j];
+    t = -alp[j];
+    DAXPY(&n, &t, v, &one, w, &one);
+    bet[j] = DDOT(&n, w, &one, w, &one);
+    if (bet[j]*(j+1) < orthTol*wn) {
+      msteps = j + 1;
+      bet[j] = sqrt(bet[j]);
+      break;
+    }
+    wn += 2.0 * bet[j];
+    bet[j] = sqrt(bet[j]);
+    t = 1.0 / bet[j];
+    DSCAL(&n, &t, w, &one);
+    /* rotate: vold <- v <- w */
+    tmp = vold;  vold = v;  v = w;  w = tmp;
+  }
+  /*-------------------- Ritz values and 'safe' bounds */
+  Malloc(S, msteps*msteps, double);
+  Malloc(ritz, msteps, double);
+  SymmTridEig(ritz, S, msteps, alp, bet);
+  double bottomBeta = bet[msteps-1], amin = INFINITY, amax = -INFINITY;
+  for (j=0; j<msteps; j++) {
+    t = fabs(bottomBeta * S[(j+1)*msteps-1]);
+    amin = min(amin, ritz[j] - t);
+    amax = max(amax, ritz[j] + t);
+  }
+  *cmin = amin;
+  *cmax = amax;
+  *tmin = ritz[0];
+  free(alp);
+  free(bet);
+  free(v);
+  free(vold);
+  free(w);
+  free(S);
+  free(ritz);
+  return 0;
+}
+
+/**
+ * @brief Chebyshev coefficients of t^{-1/2} on [c0, c1] by Chebyshev-Gauss
+ * quadrature. The degree is the smallest one for which the tail of the
+ * expansion is below tol relative to min t^{-1/2} = c1^{-1/2}
+ */
+static void bpol_coefs(bpolData *P, double tol) {
+  int j, k, npts = BPOL_NPTS;
+  double *f, *mu, th, tail;
+  Malloc(f, npts, double);
+  Calloc(mu, BPOL_MAXDEG+1, double);
+  for (j=0; j<npts; j++) {
+    th = (j + 0.5) * PI / npts;
+    f[j] = 1.0 / sqrt(P->cc + P->hh * cos(th));
+  }
+  for (k=0; k<=BPOL_MAXDEG; k++) {
+    double s = 0.0;
+    for (j=0; j<npts; j++) {
+      s += f[j] * cos(k * (j + 0.5) * PI / npts);
+    }
+    mu[k] = (k ? 2.0 : 1.0) * s / npts;
+  }
+  /*-------------------- smallest degree with a small enough tail */
+  tol /= sqrt(P->c1);
+  tail = 0.0;
+  for (k=BPOL_MAXDEG; k>0; k--) {
+    tail += fabs(mu[k]);
+    if (tail > tol) {
+      break;
+    }
+  }
+  if (k == BPOL_MAXDEG) {
+    printf("warning: the polynomial B solver has reached the max degree %d\n",
+           BPOL_MAXDEG);
+  }
+  P->deg = k;
+  Realloc(mu, k+1, double);
+  P->mu = mu;
+  free(f);
+}
+
+/* y = p(C) * x, the input x is destroyed. x and y must differ */
+static void bpol_apply(bpolData *P, double *x, double *y) {
+  int n = P->n, i, k, one = 1;
+  double *vk = x, *vkm1 = P->w+n, *vkp1 = P->w+2*n, *tmp;
+  double t1 = 1.0 / P->hh, t2 = 2.0 / P->hh, cc = P->cc, *mu = P->mu;
+  /*-------------------- y = mu_0 * T_0 x */
+  for (i=0; i<n; i++) {
+    y[i] = mu[0] * vk[i];
+  }
+  /*-------------------- T_k x = 2 (C - cc I)/hh T_{k-1} x - T_{k-2} x */
+  for (k=1; k<=P->deg; k++) {
+    matvec_csr(&P->C, vk, vkp1);
+    if (k == 1) {
+      for (i=0; i<n; i++) {
+        vkp1[i] = t1 * (vkp1[i] - cc * vk[i]);
+      }
+    } else {
+      for (i=0; i<n; i++) {
+        vkp1[i] = t2 * (vkp1[i] - cc * vk[i]) - vkm1[i];
+      }
+    }
+    DAXPY(&n, &mu[k], vkp1, &one, y, &one);
+    /* rotate: vkm1 <- vk <- vkp1 */
+    tmp = vkm1;  vkm1 = vk;  vk = vkp1;  vkp1 = tmp;
+  }
+}
+
+/* y = L \ x = p(C) D^{-1/2} x */
+static void bpol_LSol(double *x, double *y, void *data) {
+  bpolData *P = (bpolData *) data;
+  int i;
+  for (i=0; i<P->n; i++) {
+    P->w[i] = P->dsqi[i] * x[i];
+  }
+  bpol_apply(P, P->w, y);
+}
+
+/* y = L' \ x = D^{-1/2} p(C) x */
+static void bpol_LTSol(double *x, double *y, void *data) {
+  bpolData *P = (bpolData *) data;
+  int i, n = P->n, one = 1;
+  DCOPY(&n, x, &one, P->w, &one);
+  bpol_apply(P, P->w, y);
+  for (i=0; i<n; i++) {
+    y[i] *= P->dsqi[i];
+  }
+}
+
+/**
+ * @brief Set up the polynomial solver with B
+ *
+ * @param B    the SPD matrix B (both triangles stored)
+ * @param tol  relative accuracy of the approximation of C^{-1/2}
+ *
+ * @return 0 on success, -1 if B has a nonpositive diagonal entry or C is
+ * found indefinite
+ * */
+int set_pol_LBdata(csrMat *B, double tol) {
+  int i, j, n = B->nrows, nnz = B->ia[n];
+  double cmin, cmax, tmin;
+  bpolData *P;
+  Calloc(P, 1, bpolData);
+  P->n = n;
+  /*-------------------- D^{-1/2} */
+  Malloc(P->dsqi, n, double);
+  for (i=0; i<n; i++) {
+    double d = 0.0;
+    for (j=B->ia[i]; j<B->ia[i+1]; j++) {
+      if (B->ja[j] == i) {
+        d += B->a[j];
+      }
+    }
+    if (d <= 0.0) {
+      printf("error: B has a nonpositive diagonal entry %e at row %d\n", d, i);
+      free(P->dsqi);
+      free(P);
+      return -1;
+    }
+    P->dsqi[i] = 1.0 / sqrt(d);
+  }
+  /*-------------------- C = D^{-1/2} B D^{-1/2} */
+  csr_resize(n, n, nnz, &P->C);
+  memcpy(P->C.ia, B->ia, (n+1)*sizeof(int));
+  memcpy(P->C.ja, B->ja, nnz*sizeof(int));
+  for (i=0; i<n; i++) {
+    for (j=B->ia[i]; j<B->ia[i+1]; j++) {
+      P->C.a[j] = P->dsqi[i] * B->a[j] * P->dsqi[B->ja[j]];
+    }
+  }
+  /*-------------------- interval of the expansion */
+  bpol_bounds(&P->C, &cmin, &cmax, &tmin);
+  if (tmin <= 0.0) {
+    printf("error: B is not positive definite [Ritz value %e]\n", tmin);
+    free_csr(&P->C);
+    free(P->dsqi);
+    free(P);
+    return -1;
+  }
+  if (cmin <= 0.0) {
+    printf("warning: the lower bound of the spectrum of D^{-1/2}BD^{-1/2} ");
+    printf("was not found, %e is used\n", 0.5*tmin);
+    cmin = 0.5 * tmin;
+  }
+  P->c0 = cmin * (1.0 - BPOL_MARGIN);
+  P->c1 = cmax * (1.0 + BPOL_MARGIN);
+  P->cc = 0.5 * (P->c1 + P->c0);
+  P->hh = 0.5 * (P->c1 - P->c0);
+  bpol_coefs(P, tol);
+  Malloc(P->w, 3*n, double);
+  /* save the struct to global variable */
+  evsldata.LB_func_data = (void *) P;
+  evsldata.LB_solv = bpol_LSol;
+  evsldata.LBT_solv = bpol_LTSol;
+
+  return 0;
+}
+
+void free_pol_LBdata() {
+  bpolData *P = (bpolData *) evsldata.LB_func_data;
+  free_csr(&P->C);
+  free(P->dsqi);
+  free(P->mu);
+  free(P->w);
+}
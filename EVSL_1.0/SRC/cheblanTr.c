@@ -7,6 +7,223 @@
 #include "blaslapack.h"
 #include "struct.h"
 #include "internal_proto.h"
+/*-------------------- Lanczos with merged reductions: a second
+                       orthogonalization pass is done if
+                       ||w - V*h||^2 < MERGE_ETA * ||w||^2 */
+#define MERGE_ETA 1e-4
+
+/**
+ * @brief Orthogonalization of one step of the filtered Lanczos process with
+ * merged reductions [evsldata.pipelined]. w = V(:,k) = B*v is given, where
+ * B = (I-Y*Y')*p[(A-cc)/dd] and v = V(:,k-1). All the inner products of
+ * the step, alpha and ||w|| included, are computed in one reduction
+ * h = [V(:,0:k-1), w]'*w, instead of the separate alpha and the two
+ * passes of CGS_DGKS. A second pass is done only if ||w - V*h|| << ||w||.
+ * The reduction is not overlapped with the filter: the saving is the
+ * number of reductions [global synchronizations] per step
+ *
+ * @param n       size of A
+ * @param V       Lanczos vectors, V(:,0:k-1) orthonormal on entry,
+ *                V(:,k) = w orthogonalized [unnormalized] on return
+ * @param k       number of Lanczos vectors
+ * @param h       work array of size k+1
+ * @param[out] alpha, beta   alpha = v'*w and beta = ||w - V*h||
+ **/
+static void ChebLanMergedStep(int n, double *V, int k, double *h,
+                              double *alpha, double *beta) {
+  int p, one = 1, k1 = k+1;
+  char cN = 'N', cT = 'T';
+  double done = 1.0, dmone = -1.0, dzero = 0.0, ww, hh;
+  double *w = V + k*n;
+  /*-------------------- h = [V(:,0:k-1), w]'*w */
+  DGEMV(&cT, &n, &k1, &done, V, &n, w, &one, &dzero, h, &one);
+  *alpha = h[k-1];
+  for (p=0; p<2; p++) {
+    /*-------------------- ||w - V*h||^2 = w'*w - h'*h */
+    ww = h[k];
+    hh = DDOT(&k, h, &one, h, &one);
+    /*-------------------- w = w - V*h */
+    DGEMV(&cN, &n, &k, &dmone, V, &n, h, &one, &done, w, &one);
+    if (p || ww - hh >= MERGE_ETA * ww) {
+      break;
+    }
+    /*-------------------- too much cancellation: one more pass */
+    DGEMV(&cT, &n, &k1, &done, V, &n, w, &one, &dzero, h, &one);
+  }
+  *beta = sqrt(max(ww - hh, 0.0));
+}
+
+/**
+ * @brief One block of s steps of the s-step (communication-avoiding)
+ * filtered Lanczos process. The s new Krylov vectors are generated from
+ * V(:,k) with the Chebyshev basis of the filtered operator B = p[(A-cc)/dd]
+ * on [lo, hi], and orthonormalized all at once by two passes of block
+ * Gram-Schmidt, each followed by a Cholesky QR. So only a few BLAS-3
+ * reductions are needed per block instead of O(s) dot products [the locked
+ * vectors are still deflated at each step]. The s new columns of the
+ * tridiagonal matrix T are recovered from the change of basis:
+ * B * P(:,0:s-1) = P * Bc and P = V(:,0:k+s) * Rw
+ *
+ * @param A       matrix A
+ * @param pol     the polynomial filter
+ * @param n       size of A
+ * @param s       block size [number of Lanczos steps]
+ * @param lo, hi  an interval containing the spectrum of B
+ * @param V       Lanczos vectors, V(:,0:k) orthonormal on entry,
+ *                V(:,k+1:k+s) are computed
+ * @param k       index of the current Lanczos vector
+ * @param T       tridiagonal (arrowhead) matrix, columns 0:k-1 are
+ *                given, columns k:k+s-1 are computed
+ * @param ldt     leading dimension of T
+ * @param lock, Y locked vectors to be deflated
+ * @param tolS    tolerance on the error of the recovered columns of T
+ * @param work    work array of size 3*n
+ * @param[out] beta  the last off-diagonal T(k+s, k+s-1)
+ * @param[out] tmv   time of the filter applications is added to it
+ *
+ * @return s on success, 0 if the basis is numerically rank deficient or
+ * if the error of the recovered T is larger than tolS.
+ * In this case, nothing is changed in T and V(:,0:k)
+ **/
+static int ChebLanSstep(csrMat *A, polparams *pol, int n, int s, double lo,
+                        double hi, double *V, int k, double *T, int ldt,
+                        int lock, double *Y, double tolS, double *work,
+                        double *beta, double *tmv) {
+  int i, j, p, k1 = k+1, m1 = k1+s, one = 1, info;
+  char cN = 'N', cT = 'T', cU = 'U', cR = 'R', cL = 'L';
+  double done = 1.0, dmone = -1.0, dzero = 0.0, tm, rmin, rmax, err;
+  double c = 0.5 * (hi + lo), h = 0.5 * (hi - lo);
+  /*-------------------- the block to be orthonormalized: V(:,k+1:k+s) */
+  double *P = V + k1*n;
+  double *C, *Ctot, *R, *R2, *Rw, *M;
+  Malloc(C, k1*s, double);
+  Malloc(Ctot, k1*s, double);
+  Malloc(R, s*s, double);
+  Malloc(R2, s*s, double);
+  Malloc(Rw, m1*(s+1), double);
+  Malloc(M, m1*s, double);
+  /*-------------------- Chebyshev basis on [lo, hi] 
+   * p_1     = (B p_0 - c p_0) / h
+   * p_{j+1} = 2 (B p_j - c p_j) / h - p_{j-1} */
+  for (j=0; j<s; j++) {
+    double *pj = V + (k+j)*n;
+    double *pj1 = pj + n;
+    tm = cheblan_timer();
+    ChebAv(A, pol, pj, pj1, work);
+    *tmv += cheblan_timer() - tm;
+    /*-------------------- deflate the locked vectors at each step so that
+     *                     the recurrence holds for (I-Y*Y')*B */
+    if (lock > 0) {
+      CGS_DGKS(n, lock, NGS_MAX, Y, pj1, NULL, work);
+    }
+    double t1 = j ? 2.0/h : 1.0/h, t2 = -c*t1;
+    DSCAL(&n, &t1, pj1, &one);
+    DAXPY(&n, &t2, pj, &one, pj1, &one);
+    if (j) {
+      DAXPY(&n, &dmone, pj-n, &one, pj1, &one);
+    }
+  }
+  /*-------------------- two passes of block CGS against V(:,0:k), each
+   *                     followed by a Cholesky QR of the block:
+   *                     P = P - V*C_p, P = P / R_p. So in the end, 
+   *                     P_0 = V*Ctot + Q*R, Ctot = C_1 + C_2*R_1, R = R_2*R_1 */
+  for (p=0; p<2; p++) {
+    double *Rp = p ? R2 : R;
+    DGEMM(&cT, &cN, &k1, &s, &n, &done, V, &n, P, &n, &dzero, C, &k1);
+    DGEMM(&cN, &cN, &n, &s, &k1, &dmone, V, &n, C, &k1, &done, P, &n);
+    if (p == 0) {
+      memcpy(Ctot, C, k1*s*sizeof(double));
+    } else {
+      DTRMM(&cR, &cU, &cN, &cN, &k1, &s, &done, R, &s, C, &k1);
+      for (i=0; i<k1*s; i++) {
+        Ctot[i] += C[i];
+      }
+    }
+    DGEMM(&cT, &cN, &s, &s, &n, &done, P, &n, P, &n, &dzero, Rp, &s);
+    DPOTRF(&cU, &s, Rp, &s, &info);
+    if (info) {
+      break;
+    }
+    /*-------------------- the basis is (nearly) rank deficient */
+    rmin = rmax = fabs(Rp[0]);
+    for (i=1; i<s; i++) {
+      rmin = min(rmin, fabs(Rp[i*s+i]));
+      rmax = max(rmax, fabs(Rp[i*s+i]));
+    }
+    if (rmin < 1e-7 * rmax) {
+      info = 1;
+      break;
+    }
+    /*-------------------- only the upper triangular part is set by DPOTRF */
+    for (j=0; j<s; j++) {
+      for (i=j+1; i<s; i++) {
+        Rp[j*s+i] = 0.0;
+      }
+    }
+    DTRSM(&cR, &cU, &cN, &cN, &n, &s, &done, Rp, &s, P, &n);
+  }
+  if (info) {
+    free(C);  free(Ctot);  free(R);  free(R2);  free(Rw);  free(M);
+    return 0;
+  }
+  DTRMM(&cL, &cU, &cN, &cN, &s, &s, &done, R2, &s, R, &s);
+  /*-------------------- Rw = [e_k, [Ctot; R]], the coordinates of P(:,0:s)
+   *                     in the basis V(:,0:k+s) */
+  memset(Rw, 0, m1*(s+1)*sizeof(double));
+  Rw[k] = 1.0;
+  for (j=1; j<=s; j++) {
+    memcpy(Rw+j*m1, Ctot+(j-1)*k1, k1*sizeof(double));
+    memcpy(Rw+j*m1+k1, R+(j-1)*s, j*sizeof(double));
+  }
+  /*-------------------- M = Rw * Bc, Bc is the (s+1) x s tridiagonal 
+   *                     matrix of the Chebyshev recurrence */
+  for (j=0; j<s; j++) {
+    double *Mj = M + j*m1;
+    for (i=0; i<m1; i++) {
+      Mj[i] = c * Rw[j*m1+i] + (j ? 0.5*h : h) * Rw[(j+1)*m1+i];
+      if (j) {
+        Mj[i] += 0.5*h * Rw[(j-1)*m1+i];
+      }
+    }
+  }
+  /*-------------------- M(0:k,:) = M(0:k,:) - T(0:k,0:k-1) * Rw(0:k-1,0:s-1) */
+  if (k > 0) {
+    DGEMM(&cN, &cN, &k1, &s, &k, &dmone, T, &ldt, Rw, &m1, &done, M, &m1);
+  }
+  /*-------------------- H = M * Rw(k:k+s-1,0:s-1)^{-1}, which gives the 
+   *                     columns k:k+s-1 of T */
+  DTRSM(&cR, &cU, &cN, &cN, &m1, &s, &done, Rw+k, &m1, M, &m1);
+  /*-------------------- the entries of H out of the tridiagonal part must 
+   *                     agree with T. A large difference shows that the 
+   *                     rounding errors in the recovery are amplified by
+   *                     an ill-conditioned basis */
+  err = 0.0;
+  for (j=0; j<s; j++) {
+    int kj = k+j;
+    for (i=0; i<m1; i++) {
+      if (i == kj || i == kj+1) {
+        continue;
+      }
+      double tij = (i == kj-1 && j > 0) ? M[(j-1)*m1+kj] : T[kj*ldt+i];
+      err = max(err, fabs(M[j*m1+i] - tij));
+    }
+  }
+  if (err > tolS) {
+    free(C);  free(Ctot);  free(R);  free(R2);  free(Rw);  free(M);
+    return 0;
+  }
+  for (j=0; j<s; j++) {
+    int kj = k+j;
+    double bj = M[j*m1+kj+1];
+    T[kj*ldt+kj] = M[j*m1+kj];
+    T[kj*ldt+kj+1] = bj;
+    T[(kj+1)*ldt+kj] = bj;
+  }
+  *beta = M[(s-1)*m1+k+s];
+  free(C);  free(Ctot);  free(R);  free(R2);  free(Rw);  free(M);
+  return s;
+}
+
 /**
  * @brief Chebyshev polynomial filtering Lanczos process [Thick restart version]
  *
@@ -82,7 +299,7 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
   //char cT='T';
   char cN = 'N';
   int one = 1;
-  double done=1.0,dmone=-1.0,dzero=0.0;
+  double done=1.0,dmone=-1.0;
   /*--------------------   Ntest = when to start testing convergence */
   int Ntest = min(lanm, nev+50);
   /*--------------------   how often to test */
@@ -138,13 +355,32 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
   /*-------------------- nmv counts  matvecs */
   int nmv = 0;
   /*-------------------- Ritz values and vectors of p(A) */
-  double *Rval, *Rvec, *resi;
+  double *Rval, *resi;
   Malloc(Rval, lanm, double);
   Malloc(resi, lanm, double);
-  Malloc(Rvec, n*lanm, double);
   /*-------------------- Eigen vectors of T */
   double *EvecT;
   Malloc(EvecT, lanm1*lanm1, double);
+  /*-------------------- work space for the eigen-decomposition of T,
+                         reused at each convergence test */
+  trEigWork treig;
+  alloc_treig(lanm1, &treig);
+  /*-------------------- nritz = number of Ritz values >= bar */
+  int nritz = 0;
+  /*-------------------- s-step Lanczos: block size and an interval
+                         [plo, phi] containing the spectrum of p(A) */
+  int sstep = evsldata.sstep;
+  double plo = 0.0, phi = 0.0;
+  if (sstep > 1) {
+    chebxRange(deg, pol->mu, &plo, &phi);
+  }
+  /*-------------------- merged reductions: work array of the inner
+                         products */
+  int pipe = evsldata.pipelined;
+  double *hp = NULL;
+  if (pipe) {
+    Malloc(hp, lanm1+1, double);
+  }
   /*-------------------- s used by TR (spike of 1st block in Tm)*/
   double *s;
   Malloc(s, lanm, double);
@@ -160,6 +396,8 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
   Malloc(work, work_size, double);
   /*-------------------- main (restarted Lan) outer loop */
   while (it < maxit) {
+    /*-------------------- block size of s-step Lanczos in this cycle */
+    int smax = sstep;
     /*-------------------- for ortho test */
     double wn = 0.0;
     int nwn = 0;
@@ -238,78 +476,137 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
     /*------------------ Lanczos inner loop ----------------*/
     /*------------------------------------------------------*/
     while (k < lanm && it < maxit) {
-      k++;
-      /*   a quick reference to V(:,k) */
-      double *v = &V[(k-1)*n];
-      /*   next Lanczos vector */
-      double *w = v + n;
-      /*   w = p[(A-cc)/dd] * v */
-      tm = cheblan_timer();
-      ChebAv(A, pol, v, w, work);
-      tmv += cheblan_timer() - tm;
-      nmv += deg;
-      it++;
-      /*-------------------- orthgonalize vs locked ones first */
-      if (lock > 0) {
-        /*--------------------   w = w - Y*Y'*w */
-        CGS_DGKS(n, lock, NGS_MAX, Y, w, NULL, work);
-      }
-      /*--------------------  w = w - beta*vold */
-      if (vold) {
-        double nbeta = -beta;
-        DAXPY(&n, &nbeta, vold, &one, w, &one);
+      /*-------------------- s-step: perform sb steps at once, up to the
+                             next restarting test */
+      int sb = 0;
+      if (smax > 1) {
+        int kt = trlen + Ntest;
+        if (k+1 > kt) {
+          kt += (k+1-kt+cycle-1) / cycle * cycle;
+        }
+        sb = min(min(smax, lanm-k), min(maxit-it, kt-k));
+        if (sb > 1) {
+          /*-------------------- the matvecs are done even if it fails */
+          nmv += sb*deg;
+          sb = ChebLanSstep(A, pol, n, sb, plo, phi, V, k, T, lanm1, lock, Y,
+                            1e-3*tol, work, &beta, &tmv);
+          /*-------------------- failed: use smaller blocks in this cycle */
+          if (!sb) {
+            smax /= 2;
+          }
+        } else {
+          sb = 0;
+        }
+        if (sb) {
+          for (i=k; i<k+sb; i++) {
+            wn += fabs(T[i*lanm1+i]) + 2.0 * T[i*lanm1+i+1];
+          }
+          nwn += 3*sb;
+          k += sb;
+          it += sb;
+          vold = V+(k-1)*n;
+        }
       }
-      /*--------------------   alpha = w'*v */
-      double alpha = DDOT(&n, v, &one, w, &one);
-      /*--------------------   T(k,k) = alpha */
-      T[(k-1)*lanm1+(k-1)] = alpha;
-      wn += fabs(alpha);
-      /*--------------------   w = w - alpha*v */
-      double nalpha = -alpha;
-      DAXPY(&n, &nalpha, v, &one, w, &one);
-      /*   FULL reortho to all previous Lan vectors */
-      /*   w = w - V(:,1:k)*V(:,1:k)'*w */
-      /*   beta = norm(w) */
-      CGS_DGKS(n, k, NGS_MAX, V, w, &beta, work);
-      /*--------------------  T(k,k+1) = T(k+1,k) = beta */
-      T[k*lanm1+(k-1)] = beta;
-      T[(k-1)*lanm1+k] = beta;
-      wn += 2.0 * beta;
-      nwn += 3;
-      /*   vold = v */
-      vold = v;
-      /*-------------------- lucky breakdown  test */
-      if (beta*nwn < orthTol*wn) {
-        if (do_print) {
-          fprintf(fstats, "it %4d: Lucky breakdown, beta = %.15e\n", it, beta);
+      if (!sb) {
+        k++;
+        /*   a quick reference to V(:,k) */
+        double *v = &V[(k-1)*n];
+        /*   next Lanczos vector */
+        double *w = v + n;
+        double alpha;
+        if (pipe) {
+          /*-------------------- w = (I-Y*Y')*p[(A-cc)/dd] * v */
+          tm = cheblan_timer();
+          ChebAv(A, pol, v, w, work);
+          tmv += cheblan_timer() - tm;
+          nmv += deg;
+          it++;
+          if (lock > 0) {
+            CGS_DGKS(n, lock, NGS_MAX, Y, w, NULL, work);
+          }
+          /*-------------------- alpha, beta and w = w - V*h in one reduction */
+          ChebLanMergedStep(n, V, k, hp, &alpha, &beta);
+          T[(k-1)*lanm1+(k-1)] = alpha;
+          wn += fabs(alpha);
+        } else {
+          /*   w = p[(A-cc)/dd] * v */
+          tm = cheblan_timer();
+          ChebAv(A, pol, v, w, work);
+          tmv += cheblan_timer() - tm;
+          nmv += deg;
+          it++;
+          /*-------------------- orthgonalize vs locked ones first */
+          if (lock > 0) {
+            /*--------------------   w = w - Y*Y'*w */
+            CGS_DGKS(n, lock, NGS_MAX, Y, w, NULL, work);
+          }
+          /*--------------------  w = w - beta*vold */
+          if (vold) {
+            double nbeta = -beta;
+            DAXPY(&n, &nbeta, vold, &one, w, &one);
+          }
+          /*--------------------   alpha = w'*v */
+          alpha = DDOT(&n, v, &one, w, &one);
+          /*--------------------   T(k,k) = alpha */
+          T[(k-1)*lanm1+(k-1)] = alpha;
+          wn += fabs(alpha);
+          /*--------------------   w = w - alpha*v */
+          double nalpha = -alpha;
+          DAXPY(&n, &nalpha, v, &one, w, &one);
+          /*   FULL reortho to all previous Lan vectors */
+          /*   w = w - V(:,1:k)*V(:,1:k)'*w */
+          /*   beta = norm(w) */
+          CGS_DGKS(n, k, NGS_MAX, V, w, &beta, work);
         }
-        rand_double(n, w);
-        beta = DNRM2(&n, w, &one);
-        //beta = DDOT(&n, w, &one, w, &one);  beta = sqrt(beta);
+        /*--------------------  T(k,k+1) = T(k+1,k) = beta */
+        T[k*lanm1+(k-1)] = beta;
+        T[(k-1)*lanm1+k] = beta;
+        wn += 2.0 * beta;
+        nwn += 3;
+        /*   vold = v */
+        vold = v;
+        /*-------------------- lucky breakdown  test */
+        if (beta*nwn < orthTol*wn) {
+          if (do_print) {
+            fprintf(fstats, "it %4d: Lucky breakdown, beta = %.15e\n", it, beta);
+          }
+          rand_double(n, w);
+          beta = DNRM2(&n, w, &one);
+          //beta = DDOT(&n, w, &one, w, &one);  beta = sqrt(beta);
+        }
+        /*--------------------   w = w / beta */
+        double ibeta = 1.0 / beta;
+        DSCAL(&n, &ibeta, w, &one);
       }
-      /*--------------------   w = w / beta */
-      double ibeta = 1.0 / beta;
-      DSCAL(&n, &ibeta, w, &one);
       /*-------------------- Restarting test */
       k1 = k-trlen-Ntest;
       if ( ((k1>=0) && (k1 % cycle == 0)) || (k == lanm) || it == maxit) {
-        /*--------------------   solve eigen-problem for T(1:k,1:k) */
-        /*                       vals in Rval, vecs in EvecT */
-        //printf("k %d, trlen %d, Ntest %d, its %d\n", k, trlen, Ntest, it);
-        SymEigenSolver(k, T, lanm1, EvecT, lanm1, Rval);
         /*-------------------- max dim reached-break from the inner loop */
         if (k == lanm || it == maxit) {
           break;
         }
+        /*--------------------   eigenvalues of T(1:k,1:k) in Rval and only
+                                 the bottom row of its eigenvectors in resi.
+                                 Eigenvectors are computed at restart */
+        if (ArrowTridEigBot(k, trlen, T, lanm1, Rval, resi, &treig)) {
+          /*-------------------- QL failed: vals >= bar and vecs by DSTEMR */
+          ArrowTridEig(k, trlen, T, lanm1, bar-DBL_EPSILON, &nritz, Rval,
+                       EvecT, lanm1, &treig);
+          for (i=0; i<nritz; i++) {
+            resi[i] = EvecT[i*lanm1+(k-1)];
+          }
+        } else {
+          nritz = k;
+        }
         count = 0;
         /*-------------------- get residual norms and check acceptance of
           Ritz values for p(A). */
         //--------------------count e.vals in interval + those that convergeed
         jl = 0;
-        for (i=0; i<k; i++) {
+        for (i=0; i<nritz; i++) {
           if (Rval[i]>= bar) {
             jl++;
-            r = fabs(beta*EvecT[i*lanm1+(k-1)]);
+            r = fabs(beta*resi[i]);
             resi[i] = r;
             if (r < tolP) {
               count++;
@@ -336,10 +633,18 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
       /*-------------------- end of inner (Lanczos) loop - Next: restart*/        
     }     //                 while (k<mlan) loop
 
+    /*--------------------   solve eigen-problem for T(1:k,1:k) */
+    /*                       vals >= bar in Rval, vecs in EvecT */
+    ArrowTridEig(k, trlen, T, lanm1, bar-DBL_EPSILON, &nritz, Rval, EvecT,
+                 lanm1, &treig);
+    /*--------------------   residual norms from the bottom row of EvecT */
+    for (i=0; i<nritz; i++) {
+      resi[i] = fabs(beta*EvecT[i*lanm1+(k-1)]);
+    }
     /*--------------------   TWO passes to select good candidates */
     /*                       Pass-1: based on if ``p(Ritzvalue) > bar'' */	    
     jl = 0;
-    for (i=0; i<k; i++) {
+    for (i=0; i<nritz; i++) {
       /*--------------------   if this Ritz value is higher than ``bar'' */
       if (Rval[i] >= bar) {
         // move good eigenvectors/vals to front
@@ -351,8 +656,9 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
         jl++;
       }
     }
-    /*   Compute the Ritz vectors: Rvec(:,1:jl) = V(:,1:k) * EvecT(:,1:jl) */
-    DGEMM(&cN,&cN,&n,&jl,&k,&done,V,&n,EvecT,&lanm1,&dzero,Rvec,&n);
+    /*   Compute the Ritz vectors in place: 
+         V(:,1:jl) = V(:,1:k) * EvecT(:,1:jl), V(:,k+1) is untouched */
+    RitzVecsInPlace(n, k, jl, V, EvecT, lanm1, work, work_size);
     /*--------------------  Pass-2: check if Ritz vals of A are in [a,b] */
     /*                      number of Ritz values in [a,b] */
     ll = 0;
@@ -360,7 +666,7 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
     prtrlen = trlen; 
     trlen = 0;
     for (i=0; i<jl; i++) {
-      double *y = Rvec + i*n;
+      double *y = V + i*n;
       double *w = work;
       /*--------------------   normalize just in case. */
       t = DNRM2(&n, y, &one); 
@@ -443,6 +749,8 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
     }
     /*-------------------- prepare to restart.  First zero out all T */
     memset(T, 0, lanm1*lanm1*sizeof(double));
+    /* the new arrowhead part of T needs to be reduced again */
+    treig.reduced = 0;
     /* move starting vector vector V(:,k+1);  V(:,trlen+1) = V(:,k+1) */
     DCOPY(&n, V+k*n, &one, V+trlen*n, &one);
   }      /* outer loop (it) */
@@ -471,9 +779,10 @@ int ChebLanTr(csrMat *A, int lanm, int nev, double *intv, int maxit,
   free(Rval);
   free(resi);
   free(EvecT);
-  free(Rvec);
+  free_treig(&treig);
   free(s);
   free(work);
+  free(hp);
   /*-------------------- record stats */
   tall = cheblan_timer() - tall;
   /*-------------------- print stat */
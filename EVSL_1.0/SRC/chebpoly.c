@@ -3,11 +3,22 @@
 #include <math.h>
 #include <float.h>
 #include <string.h>
+#include <unistd.h>
 #include "def.h"
 #include "blaslapack.h"
 #include "struct.h"
 #include "internal_proto.h"
 
+/* default side-lobe level of the Dolph-Chebyshev damping [damping = 3] */
+#define DOLPH_LEVEL 0.01
+/* cache size [bytes] for the temporal blocking of ChebAv, if the size of
+ * the L2 cache is not known */
+#define CHEBTB_CACHE (1<<20)
+/* fraction of the cache for a block of rows */
+#define CHEBTB_FRAC 0.5
+/* min number of rows of a tile */
+#define CHEBTB_MINROWS 64
+
 /**
  * @brief set default values for polparams struct.
  **/
@@ -15,6 +26,8 @@ void set_pol_def(polparams *pol){
   pol->max_deg = 300;      // max degree allowed
   pol->min_deg = 2;        // min allowed degree
   pol->damping = 2;        // damping. 0 = no damping, 1 = Jackson, 2 = Lanczos
+                           // 3 = Dolph-Chebyshev
+  pol->sidelobe = DOLPH_LEVEL;  // side-lobe level for damping 3
   pol->thresh_ext = 0.50;  // threshold for accepting polynomial for end intervals 
   pol->thresh_int = 0.8;   // threshold for accepting polynomial for interior
                            // intervals 
@@ -26,14 +39,20 @@ void set_pol_def(polparams *pol){
  *
  * @param damping == 0 --> no damping \n
  *                == 1 --> Jackson \n
- *                == 2 --> Lanczos sigma damping
+ *                == 2 --> Lanczos sigma damping \n
+ *                == 3 --> Dolph-Chebyshev [see dampcf_dolph]
+ * @param lev       side-lobe level of damping 3 [pol->sidelobe], not
+ *                  used by the others
  * @param m         degree of the polynomial
  * @param[out] jac  output array of dampened coefficients
  * @return 0
  **/
-int dampcf(int m, int damping, double *jac){
+int dampcf(int m, int damping, double lev, double *jac){
   double thetJ = 0.0, thetL = 0.0, a1 = 0.0, a2 = 0.0, dm = (double) m;
   int k, k1;
+  if (damping == 3) {
+    return dampcf_dolph(m, lev, jac);
+  }
   if (damping==1){
     thetJ = PI/(dm+2);
     a1 = 1/(dm+2);
@@ -60,6 +79,68 @@ int dampcf(int m, int damping, double *jac){
   return (0);
 }        
 
+/**
+ * @brief Dolph-Chebyshev damping coefficients.
+ *
+ * The damped Dirac delta of degree m is the delta convolved with the kernel
+ * K(theta) = 1/2 + sum_k jac[k] cos(k theta). The Dolph-Chebyshev kernel
+ *    K(theta) ~ T_{2m}(x0 cos(theta/2)),  x0 = cosh(acosh(1/lev)/(2m)),
+ * is equiripple away from its main lobe, with side lobes of level lev
+ * relative to its peak: among all the kernels of degree m it is the one
+ * with the narrowest main lobe for this level [minimax]. So, for the same
+ * leakage of the filter outside the interval, the degree is lower than with
+ * Jackson or Lanczos damping, whose side lobes decay but are higher near
+ * the main lobe
+ *
+ * @param m         degree of the polynomial
+ * @param lev       side-lobe level, in (0, 1)
+ * @param[out] jac  output array of dampened coefficients
+ * @return 0
+ **/
+int dampcf_dolph(int m, double lev, double *jac) {
+  int j, k, N = m + 1;
+  double x0, x, ph, c2, ckm1, ck, ckp1, d0, *D;
+  if (m == 0) {
+    jac[0] = 0.5;
+    return 0;
+  }
+  x0 = cosh(acosh(1.0/lev)/(2.0*m));
+  /*-------------------- K at the N Chebyshev-Gauss points */
+  Malloc(D, N, double);
+  for (j=0; j<N; j++) {
+    ph = (j + 0.5) * PI / N;
+    x = x0 * cos(0.5*ph);
+    D[j] = x <= 1.0 ? cos(2*m*acos(x)) : cosh(2*m*acosh(x));
+  }
+  /*-------------------- cosine coefficients of K [exact, K has degree m
+   *                     in cos(theta)], cos(k ph) by the 3-term recurrence */
+  d0 = 0.0;
+  for (k=0; k<=m; k++) {
+    jac[k] = 0.0;
+  }
+  for (j=0; j<N; j++) {
+    ph = (j + 0.5) * PI / N;
+    c2 = 2.0 * cos(ph);
+    ckm1 = 1.0;
+    ck = 0.5 * c2;
+    d0 += D[j];
+    for (k=1; k<=m; k++) {
+      jac[k] += D[j] * ck;
+      ckp1 = c2 * ck - ckm1;
+      ckm1 = ck;
+      ck = ckp1;
+    }
+  }
+  /*-------------------- normalize as the other dampings: jac[k] is the
+   *                     k-th coefficient over twice the 0-th one */
+  for (k=1; k<=m; k++) {
+    jac[k] /= d0;
+  }
+  jac[0] = 0.5;
+  free(D);
+  return 0;
+}
+
 /**
  *
  *
@@ -111,6 +192,37 @@ int chebxPltd(int m, double *mu, int npts, double *xi, double *yi) {
   return 0;
 }
 
+/**
+ * @brief Estimates the range [lo, hi] of the values of the polynomial
+ * filter p_mu on [-1, 1], i.e., an interval containing the spectrum of the
+ * filtered matrix p[(A-cc)/dd]. p_mu is sampled on a grid fine enough for
+ * its degree and the interval is slightly enlarged
+ *
+ * @param m         degree of the polynomial = length(mu)-1
+ * @param mu        Chev. expansion coefficients
+ * @param[out] lo, hi  the estimated range
+ * @return 0
+ **/
+int chebxRange(int m, double *mu, double *lo, double *hi) {
+  int j, npts = 20*(m+1);
+  double *xi, *yi, del;
+  Malloc(xi, npts, double);
+  Malloc(yi, npts, double);
+  linspace(-1.0, 1.0, npts, xi);
+  chebxPltd(m, mu, npts, xi, yi);
+  *lo = *hi = yi[0];
+  for (j=1; j<npts; j++) {
+    *lo = min(*lo, yi[j]);
+    *hi = max(*hi, yi[j]);
+  }
+  del = 0.05 * (*hi - *lo);
+  *lo -= del;
+  *hi += del;
+  free(xi);
+  free(yi);
+  return 0;
+}
+
 /**
  * @brief Determines polynomial for end interval cases.
  *
@@ -257,7 +369,9 @@ int indexofSmallestElement(double *array, int size){
  * @param tha    theta_a [refer to paper]
  * @param thb    theta_b [refer to paper]
  * @param mu     expansion coefficients. 
- * @param[out] thc  value of theta_c  
+ * @param[in,out] thc  on input, a starting guess for the Newton iteration
+ * [e.g., theta_c of a nearby degree; thcIn is used if it is not in
+ * [thb, tha]], on output, the value of theta_c
 **/
 int rootchb(int m, double *v, double* jac, double thcIn, double tha, 
     double thb, double *mu, double *thc){
@@ -267,7 +381,10 @@ int rootchb(int m, double *v, double* jac, double thcIn, double tha,
   // continue to get root by solving eigv. pb
   int j, it, mm, one = 1;
   double fval = 0.0, d, *T, *g;
-  *thc = thcIn;
+  /*-------------------- start from the guess in *thc, if it is valid */
+  if (*thc < thb || *thc > tha) {
+    *thc = thcIn;
+  }
   /*-------------------- Newton iteration */
   for (it=0; it<=MaxIterBalan; it++) {
     //-------------------- Balacing the interval
@@ -348,6 +465,227 @@ int rootchb(int m, double *v, double* jac, double thcIn, double tha,
   return 0;
 }
 
+/*-------------------- cache of the filters of find_pol [SetPolCache]:
+ * the filter only depends on the interval transformed to [-1, 1] and on
+ * the parameters of the search, so it is reused by the slices and the
+ * runs with the same transformed interval, up to POLCACHE_TOL */
+#define POLCACHE_TOL 1e-12
+#define POLCACHE_MAGIC "EVSL_POLCACHE 2"
+
+typedef struct _polCacheEnt {
+  double aT, bT;            // transformed interval [key]
+  int damping, min_deg, max_deg, deg_in;   // [key], deg_in: forced degree
+  double thresh_int, thresh_ext, sidelobe; // [key]
+  int deg;                  // the filter: degree, gam, bar and mu (scaled)
+  double gam, bar, *mu;
+} polCacheEnt;
+
+static struct {
+  int on;                   // if the cache is used
+  int n, nalloc;            // number of filters, size of ent
+  int dirty;                // if filters were added since it was loaded
+  char *file;               // file that saves the filters [or NULL]
+  polCacheEnt *ent;
+} pcache;
+
+/* find the filter of the transformed interval [aT, bT] with the
+ * parameters of pol [deg_in: pol->deg on input] */
+static polCacheEnt *polcache_find(double aT, double bT, polparams *pol,
+                                  int deg_in) {
+  int i;
+  for (i=0; i<pcache.n; i++) {
+    polCacheEnt *E = &pcache.ent[i];
+    if (fabs(E->aT - aT) <= POLCACHE_TOL && fabs(E->bT - bT) <= POLCACHE_TOL &&
+        E->damping == pol->damping && E->min_deg == pol->min_deg &&
+        E->max_deg == pol->max_deg && E->deg_in == deg_in &&
+        E->thresh_int == pol->thresh_int && E->thresh_ext == pol->thresh_ext &&
+        E->sidelobe == pol->sidelobe) {
+      return E;
+    }
+  }
+  return NULL;
+}
+
+/* the filter of the key in the cache, if any, copied to mu and pol
+ * [deg, gam, bar]: the entries may move when the cache grows, so no
+ * pointer to them is kept out of the critical section, which is shared
+ * by the slices that call find_pol in parallel. Returns 1 if found */
+static int polcache_get(double aT, double bT, polparams *pol, int deg_in,
+                        double *mu) {
+  int found = 0;
+#ifdef _OPENMP
+#pragma omp critical (polcache)
+#endif
+  {
+    polCacheEnt *E = polcache_find(aT, bT, pol, deg_in);
+    if (E) {
+      memcpy(mu, E->mu, (E->deg+1)*sizeof(double));
+      pol->deg = E->deg;
+      pol->gam = E->gam;
+      pol->bar = E->bar;
+      found = 1;
+    }
+  }
+  return found;
+}
+
+/* add an entry with the key fields set, and room for deg+1 coefficients */
+static polCacheEnt *polcache_new(int deg) {
+  if (pcache.n == pcache.nalloc) {
+    pcache.nalloc = max(2*pcache.nalloc, 16);
+    Realloc(pcache.ent, pcache.nalloc, polCacheEnt);
+  }
+  polCacheEnt *E = &pcache.ent[pcache.n++];
+  E->deg = deg;
+  Malloc(E->mu, deg+1, double);
+  return E;
+}
+
+static void polcache_add(double aT, double bT, polparams *pol, int deg_in) {
+  polCacheEnt *E;
+  /* the same filter may have been added by another thread meanwhile */
+  if (polcache_find(aT, bT, pol, deg_in)) {
+    return;
+  }
+  E = polcache_new(pol->deg);
+  E->aT = aT;
+  E->bT = bT;
+  E->damping = pol->damping;
+  E->min_deg = pol->min_deg;
+  E->max_deg = pol->max_deg;
+  E->deg_in = deg_in;
+  E->thresh_int = pol->thresh_int;
+  E->thresh_ext = pol->thresh_ext;
+  E->sidelobe = pol->sidelobe;
+  E->gam = pol->gam;
+  E->bar = pol->bar;
+  memcpy(E->mu, pol->mu, (pol->deg+1)*sizeof(double));
+  pcache.dirty = 1;
+}
+
+/* read the filters saved in the file [text, %.17e round-trips doubles] */
+static void polcache_load(const char *file) {
+  char magic[32];
+  int j, k, deg, damping, min_deg, max_deg, deg_in;
+  double aT, bT, thresh_int, thresh_ext, sidelobe, gam, bar;
+  FILE *fp = fopen(file, "r");
+  if (!fp) {
+    return;
+  }
+  if (!fgets(magic, sizeof(magic), fp) ||
+      strncmp(magic, POLCACHE_MAGIC, strlen(POLCACHE_MAGIC))) {
+    printf("warning: %s is not a filter cache file, not loaded\n", file);
+    fclose(fp);
+    return;
+  }
+  while (fscanf(fp, "%lf %lf %d %d %d %d %lf %lf %lf %d %lf %lf", &aT, &bT,
+                &damping, &min_deg, &max_deg, &deg_in, &thresh_int,
+                &thresh_ext, &sidelobe, &deg, &gam, &bar) == 12) {
+    if (deg < 0 || deg > max_deg) {
+      break;
+    }
+    polCacheEnt *E = polcache_new(deg);
+    for (j=0, k=1; j<=deg && k==1; j++) {
+      k = fscanf(fp, "%lf", &E->mu[j]);
+    }
+    if (k != 1) {
+      /* truncated entry */
+      free(E->mu);
+      pcache.n--;
+      break;
+    }
+    E->aT = aT;  E->bT = bT;
+    E->damping = damping;  E->min_deg = min_deg;
+    E->max_deg = max_deg;  E->deg_in = deg_in;
+    E->thresh_int = thresh_int;  E->thresh_ext = thresh_ext;
+    E->sidelobe = sidelobe;
+    E->gam = gam;  E->bar = bar;
+  }
+  fclose(fp);
+}
+
+static void polcache_save(const char *file) {
+  int i, j;
+  FILE *fp = fopen(file, "w");
+  if (!fp) {
+    printf("warning: cannot write the filter cache file %s\n", file);
+    return;
+  }
+  fprintf(fp, "%s\n", POLCACHE_MAGIC);
+  for (i=0; i<pcache.n; i++) {
+    polCacheEnt *E = &pcache.ent[i];
+    fprintf(fp, "%.17e %.17e %d %d %d %d %.17e %.17e %.17e %d %.17e %.17e\n",
+            E->aT, E->bT, E->damping, E->min_deg, E->max_deg, E->deg_in,
+            E->thresh_int, E->thresh_ext, E->sidelobe, E->deg, E->gam, E->bar);
+    for (j=0; j<=E->deg; j++) {
+      fprintf(fp, "%.17e\n", E->mu[j]);
+    }
+  }
+  fclose(fp);
+}
+
+/**
+ * @brief Turn on the cache of the polynomial filters of find_pol. A filter
+ * is reused when the interval transformed to [-1, 1] by [lmin, lmax]
+ * and all the parameters of the search [damping, thresholds, degrees]
+ * match, so for repeated runs and symmetric slices the filter design is
+ * skipped
+ *
+ * @param file  if not NULL, the filters saved in this file [e.g., next to
+ * the matrix] are loaded, and the cache is saved to it by FreePolCache
+ */
+void SetPolCache(const char *file) {
+  FreePolCache();
+  pcache.on = 1;
+  if (file) {
+    Malloc(pcache.file, strlen(file)+1, char);
+    strcpy(pcache.file, file);
+    polcache_load(file);
+  }
+}
+
+/**
+ * @brief Save the filter cache to its file if it has new filters, free it
+ * and turn it off [called by EVSLFinish]
+ */
+void FreePolCache() {
+  int i;
+  if (pcache.file && pcache.dirty) {
+    polcache_save(pcache.file);
+  }
+  for (i=0; i<pcache.n; i++) {
+    free(pcache.ent[i].mu);
+  }
+  free(pcache.ent);
+  free(pcache.file);
+  memset(&pcache, 0, sizeof(pcache));
+}
+
+/**
+ * @brief Build the balanced (damped) Cheb. expansion of degree m for an
+ * interior interval [find_pol], and evaluate it
+ *
+ * @param[in,out] thc  theta_c: starting guess on input [see rootchb]
+ * @param[out] t     p(gam), for scaling
+ * @param[out] vals  p at the ends of the interval
+ * @return 1 if the polynomial is accepted with threshold thresh, else 0
+ **/
+static int find_pol_deg(int m, polparams *pol, double *v, double *jac,
+                        double thcIn, double tha, double thb, double *itv,
+                        double thresh, double *mu, double *thc, double *gam,
+                        double *t, double *vals) {
+  dampcf(m, pol->damping, pol->sidelobe, jac);
+  //---------------------Balacing the interval + get new mu
+  rootchb(m, v, jac, thcIn, tha, thb, mu, thc);
+  //----------------------New center 
+  *gam = cos(*thc);
+  //-------------------- for scaling
+  chebxPltd(m, mu, 1, gam, t);
+  chebxPltd(m, mu, 2, itv, vals);
+  //-------------------- test for acceptance of this pol. 
+  return vals[0] <= (*t)*thresh && vals[1] <= (*t)*thresh;
+}
+
 /**
  *
  * @brief Sets the values in pol
@@ -375,10 +713,11 @@ int rootchb(int m, double *v, double* jac, double thcIn, double tha,
 **/
 int find_pol(double *intv, polparams *pol) {
   double *mu, *v, *jac, t=0.0, itv[2],  vals[2];
-  int max_deg=pol->max_deg, min_deg=pol->min_deg, damping=pol->damping;
+  int max_deg=pol->max_deg, min_deg=pol->min_deg;
   double tha=0.0, thb=0.0, thc=0.0, thcIn=0.0;
   double gam,  thresh;
-  int m, j, nitv,  mbest; 
+  int m, j, nitv,  mbest, deg_in = pol->deg;
+  double aKey, bKey;
   /*-------------------- A few parameters to be set or reset */
   Malloc(mu, max_deg+1, double);
   pol->mu = mu;
@@ -413,6 +752,14 @@ int find_pol(double *intv, polparams *pol) {
   bb  = (bb - cc) / dd;
   aa  = max(aa, -1.0);
   bb  = min(bb,  1.0);
+  /*-------------------- filter of the same transformed interval, if any */
+  aKey = aa;
+  bKey = bb;
+  if (pcache.on && polcache_get(aKey, bKey, pol, deg_in, mu)) {
+    free(v);
+    free(jac);
+    return 0;
+  }
   //printf("transformed interval [%.15e %.15e]\n", a,b);
   thb = acos(bb);
   tha = acos(aa);
@@ -456,27 +803,57 @@ int find_pol(double *intv, polparams *pol) {
       max_deg = pol->deg;
     }
     /*-------------------- initialize v vector */
-    for (j=0; j<min_deg; j++)
+    for (j=0; j<=max_deg; j++)
       v[j] = cos(j*thb) - cos(j*tha);
-    /*-------------------- DEGREE LOOP -------------------- */
-    for (m=min_deg; m < max_deg;m++){
-      dampcf(m, damping, jac);
-      //-------------------- update v: add one more entry
-      v[m] = cos(m*thb)-cos(m*tha);
-      //---------------------Balacing the interval + get new mu
-      rootchb(m, v, jac, thcIn, tha, thb, mu, &thc);
-      //----------------------New center 
-      gam = cos(thc);
-      //-------------------- for scaling
-      chebxPltd(m, mu, 1, &gam, &t);
-      chebxPltd(m, mu, nitv, itv, vals);
-      //-------------------- test for acceptance of this pol. 
-      if (vals[0] <= t*thresh && vals[1] <= t*thresh) {
-        m++;
-        break;
+    /*-------------------- DEGREE SEARCH --------------------
+     * the smallest degree in [min_deg, max_deg-1] accepted by the test,
+     * which is (almost) monotone in the degree: bracketing by doubling
+     * the degree, then bisection. The center of each balancing starts
+     * from the one of the previous degree, so rootchb mostly needs a
+     * few Newton steps only [no eigenvalue problem] */
+    thc = thcIn;
+    if (thresh < 0.0) {
+      /*-------------------- forced degree */
+      m = max_deg - 1;
+      find_pol_deg(m, pol, v, jac, thcIn, tha, thb, itv, thresh, mu,
+                   &thc, &gam, &t, vals);
+    } else {
+      int lo = min_deg - 1, hi = -1, mlast;
+      m = min_deg;
+      while (1) {
+        if (find_pol_deg(m, pol, v, jac, thcIn, tha, thb, itv, thresh,
+                         mu, &thc, &gam, &t, vals)) {
+          hi = m;
+          break;
+        }
+        lo = m;
+        if (m == max_deg - 1) {
+          break;
+        }
+        m = min(2*m, max_deg - 1);
+      }
+      mlast = m;
+      /*-------------------- bisection in (lo, hi] */
+      if (hi > 0) {
+        while (hi - lo > 1) {
+          m = (lo + hi) / 2;
+          mlast = m;
+          if (find_pol_deg(m, pol, v, jac, thcIn, tha, thb, itv, thresh,
+                           mu, &thc, &gam, &t, vals)) {
+            hi = m;
+          } else {
+            lo = m;
+          }
+        }
+        m = hi;
+        /*-------------------- mu, t, vals must be the ones of degree hi */
+        if (mlast != hi) {
+          find_pol_deg(m, pol, v, jac, thcIn, tha, thb, itv, thresh, mu,
+                       &thc, &gam, &t, vals);
+        }
       }
     }
-    mbest = m - 1;
+    mbest = m;
     //-------------------- scale the polynomial
     for (j=0; j<=m; j++) 
       mu[j] /= t;
@@ -484,6 +861,12 @@ int find_pol(double *intv, polparams *pol) {
     pol->gam = gam;
     pol->deg = mbest;
   }
+  if (pcache.on) {
+#ifdef _OPENMP
+#pragma omp critical (polcache)
+#endif
+    polcache_add(aKey, bKey, pol, deg_in);
+  }
   free(v);
   free(jac);
   return 0;
@@ -493,6 +876,243 @@ void free_pol(polparams *pol) {
   free(pol->mu);
 }
 
+/**
+ * @brief Computes y=P(A) v by the Clenshaw (backward) recurrence
+ * [called by ChebAv if set by SetChebClenshaw]
+ *
+ * With B = (A - cc I) / dd,
+ *    b_k = mu[k] v + 2 B b_{k+1} - b_{k+2},  k = m, ..., 1,
+ *    y   = mu[0] v + B b_1 - b_2,
+ * starting from b_{m+1} = b_{m+2} = 0. The same number of matvecs as the
+ * forward recurrence, but y is written once only and b_k overwrites
+ * b_{k+2} in place: each step reads v, b_{k+1}, b_{k+2} and writes b_k,
+ * i.e., one vector stream less than the forward step [vk, vkm1, y read,
+ * vkp1, y written], and 2 vectors of work space instead of 3. The result
+ * is the same up to rounding [Clenshaw is stable on [-1, 1]]
+ *
+ * @param A Matrix A
+ * @param pol Struct containing the paramenters and expansion coefficient of
+ * the polynomail.
+ * @param v input vector
+ *
+ * @param[out] y p(A)v
+ *
+ * @b Workspace
+ * @param w Work vector of length 2*n [allocate before call]
+ * @param v is untouched
+ **/
+static int ChebAvClen(csrMat *A, polparams *pol, double *v, double *y,
+                      double *w) {
+  int n = A->nrows;
+  int *ia = A->ia;
+  int *ja = A->ja;
+  double *a = A->a;
+  double *mu = pol->mu;
+  double cc = pol->cc;
+  int m = pol->deg;
+  //-------------------- b_{k+1}, b_{k+2} from w
+  double *b1 = w;
+  double *b2 = w+n;
+  int k, i, j;
+  double r, s, t, *tmp;
+  double t1 = 1.0 / pol->dd, t2 = 2.0 / pol->dd;
+  if (m == 0) {
+    s = mu[0];
+    for (i=0; i<n; i++) {
+      y[i] = s*v[i];
+    }
+    return 0;
+  }
+  //-------------------- b_m = mu[m] * v; b_{m+1} = 0
+  s = mu[m];
+  for (i=0; i<n; i++) {
+    b1[i] = s*v[i];
+  }
+  memset(b2, 0, n*sizeof(double));
+  //-------------------- backward loop: b_k in place of b_{k+2}
+  for (k=m-1; k>=0; k--) {
+    s = mu[k];
+    t = (k==0 ? t1 : t2);
+    //-------------------- the last step writes y
+    tmp = (k==0 ? y : b2);
+    for (i=0; i<n; i++) {
+      r = -cc*b1[i];
+      for (j=ia[i]; j<ia[i+1]; j++) {
+        r += b1[ja[j]]*a[j];
+      }
+      tmp[i] = s*v[i] + t*r - b2[i];
+    }
+    //-------------------- b_{k+2} <- b_{k+1} <- b_k
+    b2 = b1;
+    b1 = tmp;
+  }
+  return 0;
+}
+
+/* size of the (per core) L2 cache */
+static double ChebTBCache() {
+  static double cache = 0.0;
+  if (cache == 0.0) {
+    cache = CHEBTB_CACHE;
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0) {
+      cache = l2;
+    }
+#endif
+  }
+  return cache;
+}
+
+/**
+ * @brief Number of steps per block of the temporal blocking of ChebAv
+ * [ChebAvTB] with A, and the bandwidth of A. In the automatic mode, it is
+ * used only if the matrix and the vectors do not fit in cache, but a
+ * block of rows for 2 steps or more does: A must be banded [the scan of A
+ * stops as soon as its bandwidth is too large]. With a forced number of
+ * steps [evsldata.chebtb > 0], the size of the cache is not checked
+ *
+ * @param[out] bw  bandwidth of A, max |i-j| for a_ij != 0
+ * @return the number of steps per block, 0 if not used
+ **/
+static int ChebAvTBScan(csrMat *A, int m, int *bw) {
+  int n = A->nrows, *ia = A->ia, *ja = A->ja, i, j, b = 0, bs, s;
+  int autom = evsldata.chebtb == 0;
+  double rowbytes, cache, rows;
+  if (evsldata.chebtb < 0 || m < 2 || n == 0) {
+    return 0;
+  }
+  /*-------------------- bytes per row: 4 vectors, ia, ja and a */
+  rowbytes = 4*sizeof(double) + sizeof(int) +
+             (sizeof(int) + sizeof(double)) * (double) ia[n] / n;
+  cache = ChebTBCache();
+  if (autom && n * rowbytes <= cache) {
+    return 0;
+  }
+  /*-------------------- rows of a block that stay in cache */
+  rows = CHEBTB_FRAC * cache / rowbytes;
+  for (i=0; i<n; i++) {
+    for (j=ia[i]; j<ia[i+1]; j++) {
+      b = max(b, abs(ja[j] - i));
+    }
+    if (autom && 4*b > rows) {
+      return 0;
+    }
+  }
+  *bw = max(b, 1);
+  bs = max(*bw, CHEBTB_MINROWS);
+  s = autom ? (int) ((rows - bs) / (*bw)) - 1 : evsldata.chebtb;
+  s = min(s, m);
+  return s >= 2 ? s : 0;
+}
+
+/**
+ * @brief ChebAvTBScan with the result kept in evsldata.chebtbplan: A is
+ * scanned again only if A, its pattern, the degree or evsldata.chebtb
+ * has changed since the last call
+ **/
+static int ChebAvTBSteps(csrMat *A, int m, int *bw) {
+  int s;
+  chebTBPlan *P = &evsldata.chebtbplan;
+  if (evsldata.chebtb < 0) {
+    return 0;
+  }
+#ifdef _OPENMP
+#pragma omp critical (chebtb_plan)
+#endif
+  {
+    if (P->A != A || P->ja != A->ja || P->n != A->nrows ||
+        P->nnz != A->ia[A->nrows] || P->deg != m ||
+        P->mode != evsldata.chebtb) {
+      P->bw = 0;
+      P->s = ChebAvTBScan(A, m, &P->bw);
+      P->A = A;
+      P->ja = A->ja;
+      P->n = A->nrows;
+      P->nnz = A->ia[A->nrows];
+      P->deg = m;
+      P->mode = evsldata.chebtb;
+    }
+    s = P->s;
+    *bw = P->bw;
+  }
+  return s;
+}
+
+/**
+ * @brief Computes y=P(A) v with temporal blocking for a banded A [matrix
+ * powers kernel, called by ChebAv]
+ *
+ * The steps of the 3-term recurrence are done by blocks of s steps. For a
+ * block, the rows are swept by tiles of bs rows, and a tile does the s
+ * steps on skewed ranges of rows [wavefront]: the step j0+l is done on the
+ * rows [t*bs - (l-1)*bw, (t+1)*bs - (l-1)*bw) of the tile t, whose
+ * neighbors [bandwidth bw] at step j0+l-1 are all known at that point.
+ * So, the rows of A and of the vectors are read from memory once for s
+ * steps and reused from cache, instead of once per step. The 3 vectors of
+ * the recurrence are the same as in ChebAv [the skew of the tiles makes
+ * sure a vector is overwritten only when it is not needed], and the
+ * result is the same, as the operations of each step are the same
+ *
+ * @param bw  bandwidth of A
+ * @param s   number of steps per block
+ * @b Workspace
+ * @param w Work vector of length 3*n [allocate before call]
+ **/
+static int ChebAvTB(csrMat *A, polparams *pol, double *v, double *y,
+                    double *w, int bw, int s) {
+  int n = A->nrows;
+  int *ia = A->ia;
+  int *ja = A->ja;
+  double *a = A->a;
+  double *mu = pol->mu;
+  double cc = pol->cc;
+  int m = pol->deg;
+  //-------------------- v_j is in vj[j%3]
+  double *vj[3] = {w, w+n, w+2*n};
+  int bs = max(bw, CHEBTB_MINROWS);
+  int j0, js, j, l, tile, ntiles, i, i0, i1, k;
+  double r, sk, t, *vk, *vkm1, *vkp1;
+  double t1 = 1.0 / pol->dd, t2 = 2.0 / pol->dd;
+  //-------------------- v_0 <- v; v_{-1} <- zeros(n,1)
+  memcpy(vj[0], v, n*sizeof(double));
+  memset(vj[2], 0, n*sizeof(double));
+  sk = mu[0];
+  for (i=0; i<n; i++) {
+    y[i] = sk*v[i];
+  }
+  //-------------------- blocks of steps j0+1, ..., j0+js
+  for (j0=0; j0<m; j0+=s) {
+    js = min(s, m-j0);
+    ntiles = (n + (js-1)*bw + bs - 1) / bs;
+    for (tile=0; tile<ntiles; tile++) {
+      for (l=1; l<=js; l++) {
+        i0 = max(0, tile*bs - (l-1)*bw);
+        i1 = min(n, (tile+1)*bs - (l-1)*bw);
+        if (i0 >= i1) {
+          continue;
+        }
+        j = j0 + l;
+        vk = vj[(j-1)%3];
+        vkm1 = vj[(j+1)%3];
+        vkp1 = vj[j%3];
+        t = (j==1 ? t1 : t2);
+        sk = mu[j];
+        for (i=i0; i<i1; i++) {
+          r = -cc*vk[i];
+          for (k=ia[i]; k<ia[i+1]; k++) {
+            r += vk[ja[k]]*a[k];
+          }
+          r = r*t - vkm1[i];
+          vkp1[i] = r;
+          y[i] += sk*r;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
 /**
  * @brief Computes y=P(A) y, where pn is a Cheb. polynomial expansion [this
  * does not call matvec - but does the sparse matrix vetor product internally]
@@ -510,11 +1130,20 @@ void free_pol(polparams *pol) {
  **/
 int ChebAv(csrMat *A, polparams *pol, double *v, double *y, double *w) {
   /* if user-provided matvec, OR, generalized e.v. prob,
-   * use another version which calls matvec_genev routine */
+   * use another version which calls matvec_genev routine, or the
+   * fused matvec and filter steps when they are available */
   if (evsldata.Amatvec.func || evsldata.hasB) {
     int err = ChebAv0(A, pol, v, y, w);
     return err;
   }
+  if (evsldata.chebclen) {
+    return ChebAvClen(A, pol, v, y, w);
+  }
+  /*-------------------- temporal blocking for a banded A */
+  int bw, nsteps = ChebAvTBSteps(A, pol->deg, &bw);
+  if (nsteps) {
+    return ChebAvTB(A, pol, v, y, w, bw, nsteps);
+  }
   //-------------------- unpack A 
   int n = A->nrows;
   int  *ia = A->ia;
@@ -570,12 +1199,14 @@ int ChebAv(csrMat *A, polparams *pol, double *v, double *y, double *w) {
 }
 
 /**
- * @brief @b UNUSED Computes y=P(A) y, where pn is a Cheb. polynomial expansion [this
- * does not call matvec - but does the sparse matrix vetor product internally]
+ * @brief Computes y=P(A) y, where pn is a Cheb. polynomial expansion, for
+ * a user matvec function or a generalized e.v. problem [called by ChebAv]
  * 
- * This is unused but left here on purpose. It is a simpler but a bit slower
- * routine. This explicitly calls matvec, so it can be useful for implementing
- * user-specific matrix-vector multiplication.
+ * It is a simpler but a bit slower routine. This explicitly calls matvec,
+ * so it can be useful for implementing user-specific matrix-vector
+ * multiplication. When a matvec fused with the filter steps is available
+ * [SetMatvecChebFunc, or LB_chebstep of the default solver with B], each
+ * step of the recurrence is done in one pass by it instead
  *
  * @param A Matrix A
  * @param pol Struct containing the paramenters and expansion coefficient of
@@ -610,6 +1241,19 @@ int ChebAv0(csrMat *A, polparams *pol, double *v, double *y, double *w) {
   int k, i; 
   double t,  s, *tmp, t1= 1./dd, t2 = 2.0/dd; 
   double zer = 0.0;
+  //-------------------- fused matvec and filter step, if any
+  MVChebFunc mvstep = NULL;
+  LBChebFunc lbstep = NULL;
+  double *wlb = NULL;
+  if (!evsldata.hasB) {
+    mvstep = evsldata.Amatvec.chebfunc;
+  } else if (!evsldata.Amatvec.func) {
+    lbstep = evsldata.LB_chebstep;
+  }
+  //-------------------- work array of the fused step with B [of this call]
+  if (lbstep) {
+    Malloc(wlb, n, double);
+  }
   //-------------------- vk <- v; vkm1 <- zeros(n,1)
   memcpy(vk, v, n*sizeof(double));
   memset(vkm1,zer,n*sizeof(double));
@@ -623,13 +1267,19 @@ int ChebAv0(csrMat *A, polparams *pol, double *v, double *y, double *w) {
     t = (k==1 ? t1:t2); 
     /*-------------------- Vkp1 = A*Vk - cc*Vk; */    
     s = mu[k];
-    
-    matvec_genev(A, vk, vkp1);
 
-    for (i=0; i<n; i++){
-      vkp1[i] = t*(vkp1[i]-cc*vk[i]) - vkm1[i];
-      //-------------------- for degree 2 and up: 
-      y[i] += s*vkp1[i];
+    if (lbstep) {
+      lbstep(A, t, cc, s, vk, vkm1, vkp1, y, wlb, evsldata.LB_func_data);
+    } else if (mvstep) {
+      mvstep(t, cc, s, vk, vkm1, vkp1, y, evsldata.Amatvec.data);
+    } else {
+      matvec_genev(A, vk, vkp1);
+
+      for (i=0; i<n; i++){
+        vkp1[i] = t*(vkp1[i]-cc*vk[i]) - vkm1[i];
+        //-------------------- for degree 2 and up: 
+        y[i] += s*vkp1[i];
+      }
     }
     //-------------------- next: rotate vectors via pointer exchange
     tmp = vkm1;
@@ -637,6 +1287,7 @@ int ChebAv0(csrMat *A, polparams *pol, double *v, double *y, double *w) {
     vk = vkp1;
     vkp1 = tmp;
   }
+  free(wlb);
   return 0;
 }
 
@@ -0,0 +1,413 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "def.h"
+#include "struct.h"
+#include "internal_proto.h"
+
+/**
+ * @file cocg.c
+ * @brief Built-in iterative solver for the shifted systems (A - z_k I) x = b
+ * of the rational filter: preconditioned COCG (conjugate orthogonal
+ * conjugate gradient), i.e., CG with the unconjugated inner product x^T y,
+ * for which A - z_k I is complex symmetric. It only needs matvecs with A,
+ * so it works with a user matvec function and needs no factorization
+ */
+
+/* max number of COCG iterations for one solve */
+#define COCG_MAXIT 2000
+/* relative residual tolerance of the solves = COCG_TOLFAC * Lanczos tol,
+ * unless set by the users [ratparams.soltol] */
+#define COCG_TOLFAC 0.1
+
+/* data of the COCG solver for one pole */
+typedef struct _cocgData {
+  int n;
+  csrMat *A;            // the matrix [NULL if a matvec function is used]
+  complex double sigma; // the shift z_k
+  double tol;           // relative residual tolerance
+  int maxit;            // max number of iterations
+  linSolFunc prec;      // preconditioner: z = M \ r, M ~ A - sigma I
+  void *precdata;       // [if prec is NULL: Jacobi, with dinv]
+  complex double *dinv; // inverse of the diagonal of A - sigma I
+  int niter;            // total number of iterations performed
+  complex double *r, *z, *p, *q, *x; // work arrays of size n
+  double *w;            // real work array of size 4*n
+} cocgData;
+
+/* q = (A - sigma I) * p */
+static void cocg_matvec(cocgData *D, complex double *p, complex double *q) {
+  int i, n = D->n;
+  double *pr = D->w, *pz = pr + n, *qr = pz + n, *qz = qr + n;
+  /*-------------------- A is real: apply it to the real/imag parts */
+  for (i=0; i<n; i++) {
+    pr[i] = creal(p[i]);
+    pz[i] = cimag(p[i]);
+  }
+  matvec_A(D->A, pr, qr);
+  matvec_A(D->A, pz, qz);
+  for (i=0; i<n; i++) {
+    q[i] = qr[i] + qz[i] * I - D->sigma * p[i];
+  }
+}
+
+/* z = M \ r */
+static void cocg_prec(cocgData *D, complex double *r, complex double *z) {
+  int i, n = D->n;
+  if (D->prec) {
+    double *rr = D->w, *rz = rr + n, *zr = rz + n, *zz = zr + n;
+    for (i=0; i<n; i++) {
+      rr[i] = creal(r[i]);
+      rz[i] = cimag(r[i]);
+    }
+    (D->prec)(n, rr, rz, zr, zz, D->precdata);
+    for (i=0; i<n; i++) {
+      z[i] = zr[i] + zz[i] * I;
+    }
+  } else {
+    for (i=0; i<n; i++) {
+      z[i] = D->dinv[i] * r[i];
+    }
+  }
+}
+
+/* preconditioned COCG for (A - sigma I) x = b with x0 = 0. On entry, D->r
+ * holds b. The iteration stops when ||r|| <= tol*||b|| */
+static void cocg_solve(cocgData *D, complex double *x) {
+  int i, it, n = D->n;
+  complex double *r = D->r, *z = D->z, *p = D->p, *q = D->q;
+  complex double rho, rho1, pq, alpha, beta;
+  double nrmb = 0.0, nrmr;
+  for (i=0; i<n; i++) {
+    nrmb += creal(r[i] * conj(r[i]));
+    x[i] = 0.0;
+  }
+  nrmb = sqrt(nrmb);
+  if (nrmb == 0.0) {
+    return;
+  }
+  cocg_prec(D, r, z);
+  rho = 0.0;
+  for (i=0; i<n; i++) {
+    p[i] = z[i];
+    rho += r[i] * z[i];
+  }
+  for (it=0; it<D->maxit; it++) {
+    /*-------------------- q = (A - sigma I) p */
+    cocg_matvec(D, p, q);
+    pq = 0.0;
+    for (i=0; i<n; i++) {
+      pq += p[i] * q[i];
+    }
+    /*-------------------- breakdown of the unconjugated inner product */
+    if (pq == 0.0) {
+      break;
+    }
+    alpha = rho / pq;
+    nrmr = 0.0;
+    for (i=0; i<n; i++) {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+      nrmr += creal(r[i] * conj(r[i]));
+    }
+    if (sqrt(nrmr) <= D->tol * nrmb) {
+      it++;
+      break;
+    }
+    cocg_prec(D, r, z);
+    rho1 = 0.0;
+    for (i=0; i<n; i++) {
+      rho1 += r[i] * z[i];
+    }
+    beta = rho1 / rho;
+    rho = rho1;
+    for (i=0; i<n; i++) {
+      p[i] = z[i] + beta * p[i];
+    }
+  }
+  D->niter += it;
+}
+
+/**
+ * @brief Complex linear solver routine passed to evsl [linSolFunc]:
+ * solves (A - z_k I) x = b by preconditioned COCG, with x0 = 0
+ */
+void cocg_solvefunc(int n, double *br, double *bz, double *xr, double *xz,
+                    void *data) {
+  cocgData *D = (cocgData *) data;
+  int i;
+  for (i=0; i<n; i++) {
+    D->r[i] = br[i] + bz[i] * I;
+  }
+  cocg_solve(D, D->x);
+  for (i=0; i<n; i++) {
+    xr[i] = creal(D->x[i]);
+    xz[i] = cimag(D->x[i]);
+  }
+}
+
+/**
+ * @brief Same as cocg_solvefunc with interleaved complex vectors
+ * [linSolFuncZ]
+ */
+void cocg_solvefunc_z(int n, complex double *b, complex double *x,
+                      void *data) {
+  cocgData *D = (cocgData *) data;
+  memcpy(D->r, b, n*sizeof(complex double));
+  cocg_solve(D, x);
+}
+
+/**
+ * @brief Set the built-in iterative solver (preconditioned COCG) for all
+ * the poles of the rational filter
+ *
+ * @param A       the matrix [can be NULL if a matvec function is set]
+ * @param prec    [optional] array of rat->num preconditioners (linSolFunc)
+ *                with prec[k] approximating (A - z_k I)^{-1}. Default
+ *                [NULL]: Jacobi preconditioner if A is given
+ * @param precdata [optional] data of the preconditioners
+ *
+ * The tolerance of the solves is rat->soltol if it is positive, otherwise
+ * it follows the tolerance of the Lanczos process [see ratf_set_soltol]
+ */
+int set_ratf_solfunc_iter(ratparams *rat, csrMat *A, linSolFunc *prec,
+                          void **precdata) {
+  int i, j, k, n;
+  /* if users provided their own matvec function, input matrix A will be ignored */
+  if (evsldata.Amatvec.func) {
+    n = evsldata.Amatvec.n;
+  } else if (A) {
+    n = A->nrows;
+  } else {
+    printf("error: no matrix for the iterative solver\n");
+    return -1;
+  }
+  /* (re)allocate enough space (number of poles) */
+  Realloc(rat->solshift, rat->num, linSolFunc);
+  Realloc(rat->solshiftdata, rat->num, void *);
+  Realloc(rat->solshiftz, rat->num, linSolFuncZ);
+  free(rat->solshiftblk);
+  rat->solshiftblk = NULL;
+  rat->use_default_solver = RATF_SOLVER_COCG;
+  for (k=0; k<rat->num; k++) {
+    cocgData *D;
+    Malloc(D, 1, cocgData);
+    D->n = n;
+    D->A = A;
+    D->sigma = rat->zk[k];
+    D->tol = rat->soltol > 0.0 ? rat->soltol : COCG_TOLFAC;
+    D->maxit = COCG_MAXIT;
+    D->prec = prec ? prec[k] : NULL;
+    D->precdata = precdata ? precdata[k] : NULL;
+    D->dinv = NULL;
+    D->niter = 0;
+    Malloc(D->r, n, complex double);
+    Malloc(D->z, n, complex double);
+    Malloc(D->p, n, complex double);
+    Malloc(D->q, n, complex double);
+    Malloc(D->x, n, complex double);
+    Malloc(D->w, 4*n, double);
+    if (D->prec == NULL) {
+      /*-------------------- Jacobi: 1 / (A(i,i) - sigma) */
+      Malloc(D->dinv, n, complex double);
+      for (i=0; i<n; i++) {
+        double aii = 0.0;
+        if (A && !evsldata.Amatvec.func) {
+          for (j=A->ia[i]; j<A->ia[i+1]; j++) {
+            if (A->ja[j] == i) {
+              aii += A->a[j];
+            }
+          }
+        }
+        D->dinv[i] = 1.0 / (aii - D->sigma);
+      }
+    }
+    rat->solshift[k] = cocg_solvefunc;
+    rat->solshiftz[k] = cocg_solvefunc_z;
+    rat->solshiftdata[k] = D;
+  }
+  return 0;
+}
+
+/**
+ * @brief Couple the tolerance of the iterative shifted solves to the
+ * tolerance tol of the Lanczos process [called by the rational Lanczos
+ * routines]: if rat->soltol is not set, the relative residual of the
+ * solves is reduced to COCG_TOLFAC*tol
+ */
+void ratf_set_soltol(ratparams *rat, double tol) {
+  int k;
+  if (rat->use_default_solver < RATF_SOLVER_COCG || rat->soltol > 0.0) {
+    return;
+  }
+  for (k=0; k<rat->num; k++) {
+    cocgData *D = (cocgData *) rat->solshiftdata[k];
+    D->tol = COCG_TOLFAC * tol;
+  }
+}
+
+/**
+ * @brief Total number of COCG iterations performed for the poles
+ */
+int ratf_iter_count(ratparams *rat) {
+  int k, nit = 0;
+  if (rat->use_default_solver < RATF_SOLVER_COCG) {
+    return 0;
+  }
+  for (k=0; k<rat->num; k++) {
+    nit += ((cocgData *) rat->solshiftdata[k])->niter;
+  }
+  return nit;
+}
+
+/**
+ * @brief Free the data of the COCG solvers set by set_ratf_solfunc_iter
+ */
+void free_rat_iter_sol(ratparams *rat) {
+  int k;
+  for (k=0; k<rat->num; k++) {
+    cocgData *D = (cocgData *) rat->solshiftdata[k];
+    free(D->dinv);
+    free(D->r);
+    free(D->z);
+    free(D->p);
+    free(D->q);
+    free(D->x);
+    free(D->w);
+    free(D);
+  }
+}
+
+/**
+ * @brief Apply the rational filter with multi-shift COCG: x = R(A) b
+ *
+ * For poles of multiplicity 1, R(A)b = 2 Re(sum_k omega_k (A - z_k I)^{-1} b),
+ * and all the shifted systems have the same Krylov space K(A, b). COCG is
+ * run on the seed system with the pole closest to the real axis (the
+ * slowest to converge) and the solutions of the other poles are updated
+ * from the seed residuals with the shifted recurrences of [Frommer 2003],
+ * so each iteration costs one matvec for all the poles. The seed runs
+ * without preconditioning, which would break the shift invariance.
+ * The work space is taken from the data of the poles
+ * [set_ratf_solfunc_iter]
+ */
+void ratf_multishift_apply(int n, ratparams *rat, double *b, double *x) {
+  int i, k, it, s = 0, nact, num = rat->num;
+  complex double *zk = rat->zk, *omega = rat->omega;
+  cocgData **D = (cocgData **) rat->solshiftdata;
+  complex double *r, *p, *q, rho, rho1, pq, alpha, beta;
+  complex double alpha0 = 1.0, beta0 = 0.0;
+  complex double *zeta, *zeta0, *zeta1, *sig;
+  int *act;
+  double nrmb = 0.0, nrmr, tol;
+  /*-------------------- seed: the pole with the smallest imaginary part */
+  for (k=1; k<num; k++) {
+    if (cimag(zk[k]) < cimag(zk[s])) {
+      s = k;
+    }
+  }
+  r = D[s]->r;
+  p = D[s]->z;
+  q = D[s]->q;
+  tol = D[s]->tol;
+  Malloc(zeta, 3*num, complex double);
+  zeta0 = zeta + num;
+  zeta1 = zeta0 + num;
+  Malloc(sig, num, complex double);
+  Malloc(act, num, int);
+  /*-------------------- r = p = p_k = b, x = 0 */
+  for (i=0; i<n; i++) {
+    r[i] = p[i] = b[i];
+    nrmb += b[i]*b[i];
+    x[i] = 0.0;
+  }
+  nrmb = sqrt(nrmb);
+  if (nrmb == 0.0) {
+    free(zeta);
+    free(sig);
+    free(act);
+    return;
+  }
+  for (k=0; k<num; k++) {
+    memcpy(D[k]->p, r, n*sizeof(complex double));
+    /*-------------------- A - z_k I = (A - z_s I) + sig_k I */
+    sig[k] = zk[s] - zk[k];
+    zeta[k] = zeta0[k] = 1.0;
+    act[k] = 1;
+  }
+  nact = num;
+  rho = 0.0;
+  for (i=0; i<n; i++) {
+    rho += r[i] * r[i];
+  }
+  for (it=0; it<D[s]->maxit && nact>0; it++) {
+    /*-------------------- q = (A - z_s I) p */
+    cocg_matvec(D[s], p, q);
+    pq = 0.0;
+    for (i=0; i<n; i++) {
+      pq += p[i] * q[i];
+    }
+    if (pq == 0.0) {
+      break;
+    }
+    alpha = rho / pq;
+    /*-------------------- update the solutions of the active shifts:
+     *                     x += 2 Re(omega_k alpha_k p_k) */
+    for (k=0; k<num; k++) {
+      complex double ak, c;
+      complex double *pk = D[k]->p;
+      if (!act[k]) {
+        continue;
+      }
+      zeta1[k] = zeta[k] * zeta0[k] * alpha0 /
+                 (alpha * beta0 * (zeta0[k] - zeta[k]) +
+                  zeta0[k] * alpha0 * (1.0 + sig[k] * alpha));
+      ak = alpha * zeta1[k] / zeta[k];
+      c = 2.0 * omega[k] * ak;
+      for (i=0; i<n; i++) {
+        x[i] += creal(c * pk[i]);
+      }
+    }
+    /*-------------------- seed residual */
+    rho1 = 0.0;
+    nrmr = 0.0;
+    for (i=0; i<n; i++) {
+      r[i] -= alpha * q[i];
+      rho1 += r[i] * r[i];
+      nrmr += creal(r[i] * conj(r[i]));
+    }
+    nrmr = sqrt(nrmr);
+    beta = rho1 / rho;
+    rho = rho1;
+    for (i=0; i<n; i++) {
+      p[i] = r[i] + beta * p[i];
+    }
+    /*-------------------- search directions of the shifts. The residual
+     *                     of shift k is zeta_k * r */
+    for (k=0; k<num; k++) {
+      complex double bk, z1;
+      complex double *pk = D[k]->p;
+      if (!act[k]) {
+        continue;
+      }
+      z1 = zeta1[k];
+      bk = (z1 / zeta[k]) * (z1 / zeta[k]) * beta;
+      for (i=0; i<n; i++) {
+        pk[i] = z1 * r[i] + bk * pk[i];
+      }
+      zeta0[k] = zeta[k];
+      zeta[k] = z1;
+      if (cabs(z1) * nrmr <= tol * nrmb) {
+        act[k] = 0;
+        nact--;
+      }
+    }
+    alpha0 = alpha;
+    beta0 = beta;
+  }
+  D[s]->niter += it;
+  free(zeta);
+  free(sig);
+  free(act);
+}
@@ -1,4 +1,7 @@
 #include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "def.h"
 #include "struct.h"
 #include "internal_proto.h"
@@ -9,6 +12,7 @@ evslData evsldata;
 void EVSLStart() {
   evsldata.Amatvec.n = -1;
   evsldata.Amatvec.func = NULL;
+  evsldata.Amatvec.chebfunc = NULL;
   evsldata.Amatvec.data = NULL;
   evsldata.hasB = 0;
   evsldata.isDefaultLB = 0;
@@ -16,18 +20,33 @@ void EVSLStart() {
   evsldata.LBT_mult = NULL;
   evsldata.LB_solv = NULL;
   evsldata.LBT_solv = NULL;
+  evsldata.LB_genmv = NULL;
+  evsldata.LB_chebstep = NULL;
   evsldata.LB_func_data = NULL;
   evsldata.matvec_gen_work = NULL;
+  evsldata.sstep = 1;
+  evsldata.pipelined = 0;
+  evsldata.chebclen = 0;
+  evsldata.chebtb = 0;
+  evsldata.chebtbplan.A = NULL;
 }
 
 void EVSLFinish() {
-  if (evsldata.hasB && evsldata.isDefaultLB) {
+#ifdef EVSL_WITH_SUITESPARSE
+  if (evsldata.hasB && evsldata.isDefaultLB == 1) {
     free_default_LBdata();
     free(evsldata.LB_func_data);
   }
+#endif
+  if (evsldata.hasB && evsldata.isDefaultLB == 2) {
+    free_pol_LBdata();
+    free(evsldata.LB_func_data);
+  }
   if (evsldata.matvec_gen_work) {
     free(evsldata.matvec_gen_work);
   }
+  FreeFactCache();
+  FreePolCache();
 }
 
 void SetMatvecFunc(int n, MVFunc func, void *data) {
@@ -36,12 +55,45 @@ void SetMatvecFunc(int n, MVFunc func, void *data) {
   evsldata.Amatvec.data = data;
 }
 
+/* set a matvec function fused with the filter steps, which is used in
+ * place of the matvec function [same data] in the polynomial filter */
+void SetMatvecChebFunc(MVChebFunc func) {
+  evsldata.Amatvec.chebfunc = func;
+}
+
 void UnsetMatvecFunc() {
   evsldata.Amatvec.n = -1;
   evsldata.Amatvec.func = NULL;
+  evsldata.Amatvec.chebfunc = NULL;
   evsldata.Amatvec.data = NULL;
 }
 
+/* set the block size s of the s-step filtered Lanczos */
+void SetLanSstep(int s) {
+  evsldata.sstep = s;
+}
+
+/* merge the reductions of a filtered Lanczos step [1] or not [0]: one
+ * reduction per step instead of several [see ChebLanMergedStep]. This is
+ * reduction merging only, the reductions are not overlapped with the
+ * filter */
+void SetLanPipelined(int pipe) {
+  evsldata.pipelined = pipe;
+}
+
+/* apply the polynomial filters by the Clenshaw recurrence [1] or by the
+ * forward 3-term recurrence [0] */
+void SetChebClenshaw(int clen) {
+  evsldata.chebclen = clen;
+}
+
+/* temporal blocking of the polynomial filters for banded matrices:
+ * s = 0: used if the blocks fit in cache [default], s < 0: not used,
+ * s > 0: used with s steps per block */
+void SetChebTBlock(int s) {
+  evsldata.chebtb = s;
+}
+
 int SetRhsMatrix(csrMat *B) {
   int err;
 #ifdef EVSL_WITH_SUITESPARSE
@@ -58,19 +110,40 @@ int SetRhsMatrix(csrMat *B) {
   return err;
 }
 
+/* set matrix B without factorization: L \ x and L' \ x are
+ * applied by a polynomial in B [see bpolsol.c] */
+int SetRhsMatrixPol(csrMat *B, double tol) {
+  int err;
+  err = set_pol_LBdata(B, tol);
+  if (err) {
+    return err;
+  }
+  evsldata.hasB = 1;
+  evsldata.isDefaultLB = 2;
+  /* alloc some workspace */
+  Malloc(evsldata.matvec_gen_work, 2*B->nrows, double);
+  return 0;
+}
+
 void UnsetRhsMatrix() {
 #ifdef EVSL_WITH_SUITESPARSE
-  if (evsldata.hasB && evsldata.isDefaultLB) {
+  if (evsldata.hasB && evsldata.isDefaultLB == 1) {
     free_default_LBdata();
     free(evsldata.LB_func_data);
   }
 #endif
+  if (evsldata.hasB && evsldata.isDefaultLB == 2) {
+    free_pol_LBdata();
+    free(evsldata.LB_func_data);
+  }
   evsldata.hasB = 0;
   evsldata.isDefaultLB = 0;
   evsldata.LB_mult = NULL;
   evsldata.LBT_mult = NULL;
   evsldata.LB_solv = NULL;
   evsldata.LBT_solv = NULL;
+  evsldata.LB_genmv = NULL;
+  evsldata.LB_chebstep = NULL;
   evsldata.LB_func_data = NULL;
   if (evsldata.matvec_gen_work) {
     free(evsldata.matvec_gen_work);
@@ -85,11 +158,30 @@ int matvec_genev(csrMat *A, double *x, double *y) {
     matvec_A(A, x, y);
     return 0;
   }
-  /* for gen e.v, y = L \ A / L' *x */
   double *w = evsldata.matvec_gen_work;
-  evsldata.LBT_solv(x, y, evsldata.LB_func_data);
-  matvec_A(A, y, w);
-  evsldata.LB_solv(w, y, evsldata.LB_func_data);
+#ifdef _OPENMP
+  /* concurrent calls [e.g., slices in parallel]: a work array of each
+   * thread instead of the global one */
+  int own = omp_in_parallel();
+  if (own) {
+    Malloc(w, evsldata.Amatvec.func ? evsldata.Amatvec.n : A->nrows,
+           double);
+  }
+#endif
+  if (evsldata.LB_genmv && !evsldata.Amatvec.func) {
+    /* fused kernel with a CSR matrix A */
+    evsldata.LB_genmv(A, x, y, w, evsldata.LB_func_data);
+  } else {
+    /* for gen e.v, y = L \ A / L' *x */
+    evsldata.LBT_solv(x, y, evsldata.LB_func_data);
+    matvec_A(A, y, w);
+    evsldata.LB_solv(w, y, evsldata.LB_func_data);
+  }
+#ifdef _OPENMP
+  if (own) {
+    free(w);
+  }
+#endif
   return 0;
 }
 
@@ -5,6 +5,7 @@
 
 #include <stdio.h>
 #include <string.h>  // for memcpy, strcmp, strncmp, etc.
+#include <float.h>
 #include "def.h"
 #include "blaslapack.h"
 #include "struct.h"
@@ -161,6 +162,326 @@ void SymEigenSolver(int n, double *A, int lda,
     free(work);
 }
 
+/**
+ * @brief Allocate work space for ArrowTridEig
+ * @param ldt  max dimension of the matrix T [lanm+1]
+ * @param[out] ws  work space, to be freed by free_treig
+ **/
+void alloc_treig(int ldt, trEigWork *ws) {
+  ws->ldt = ldt;
+  ws->trlen = 0;
+  ws->reduced = 0;
+  Malloc(ws->Qa, ldt*ldt, double);
+  Malloc(ws->da, ldt, double);
+  Malloc(ws->ea, ldt, double);
+  Malloc(ws->d, ldt, double);
+  Malloc(ws->e, ldt, double);
+  Malloc(ws->Z, ldt*ldt, double);
+  /* 18*ldt is needed by DSTEMR, DSYTRD/DORGTR need ldt for tau +
+   * a block size times ldt */
+  ws->lwork = 32*ldt;
+  Malloc(ws->work, ws->lwork, double);
+  ws->liwork = 10*ldt;
+  Malloc(ws->iwork, ws->liwork, int);
+  Malloc(ws->isuppz, 2*ldt, int);
+}
+
+void free_treig(trEigWork *ws) {
+  free(ws->Qa);
+  free(ws->da);
+  free(ws->ea);
+  free(ws->d);
+  free(ws->e);
+  free(ws->Z);
+  free(ws->work);
+  free(ws->iwork);
+  free(ws->isuppz);
+}
+
+/**
+ * @brief Reduce the leading (trlen+1) x (trlen+1) arrowhead block of T to
+ * tridiagonal form.
+ *
+ * The arrowhead block [diag(theta), s; s', alpha] is permuted to
+ * [alpha, s'; s, diag(theta)] and reduced by DSYTRD, which leaves the first
+ * row/column unchanged. Reversing the order of the result puts the tip
+ * alpha last, next to the tridiagonal part of T. So,
+ * T(0:trlen,0:trlen) = Qa * tridiag(ea, da, ea) * Qa'
+ **/
+static int ArrowReduce(int trlen, double *T, int ldt, trEigWork *ws) {
+  char uplo = 'L';
+  int i, p, q, info, t1 = trlen + 1;
+  int lwork = ws->lwork - t1;
+  double *A = ws->Z, *D = ws->d, *E = ws->e;
+  double *tau = ws->work, *work = ws->work + t1;
+  /*-------------------- A = permuted arrowhead block */
+  for (i=0; i<t1*t1; i++) {
+    A[i] = 0.0;
+  }
+  A[0] = T[trlen*ldt+trlen];
+  for (q=1; q<t1; q++) {
+    A[q] = T[(q-1)*ldt+trlen];
+    A[q*t1+q] = T[(q-1)*ldt+(q-1)];
+  }
+  /*-------------------- reduce to tridiagonal form and form Q */
+  DSYTRD(&uplo, &t1, A, &t1, D, E, tau, work, &lwork, &info);
+  if (info) {
+    printf("dsytrd_ error %d\n", info);
+    return info;
+  }
+  DORGTR(&uplo, &t1, A, &t1, tau, work, &lwork, &info);
+  if (info) {
+    printf("dorgtr_ error %d\n", info);
+    return info;
+  }
+  /*-------------------- reverse the order and undo the permutation */
+  for (p=0; p<t1; p++) {
+    ws->da[p] = D[trlen-p];
+    if (p < trlen) {
+      ws->ea[p] = E[trlen-1-p];
+    }
+    for (q=0; q<t1; q++) {
+      ws->Qa[p*t1+(q ? q-1 : trlen)] = A[(trlen-p)*t1+q];
+    }
+  }
+  ws->trlen = trlen;
+  ws->reduced = 1;
+  return 0;
+}
+
+/**
+ * @brief Form in ws->d and ws->e the tridiagonal matrix that is similar to
+ * the k x k thick restart matrix T. The arrowhead block is reduced if this
+ * has not been done since the last restart
+ **/
+static int ArrowTridForm(int k, int trlen, double *T, int ldt, trEigWork *ws) {
+  int j, info;
+  double *d = ws->d, *e = ws->e;
+  /*-------------------- reduce the arrowhead block once */
+  if (trlen > 0 && (!ws->reduced || ws->trlen != trlen)) {
+    info = ArrowReduce(trlen, T, ldt, ws);
+    if (info) {
+      return info;
+    }
+  }
+  for (j=0; j<k; j++) {
+    d[j] = (trlen > 0 && j <= trlen) ? ws->da[j] : T[j*ldt+j];
+    if (j < k-1) {
+      e[j] = (trlen > 0 && j < trlen) ? ws->ea[j] : T[j*ldt+j+1];
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Compute the eigenvalues >= vl and the associated eigenvectors of the
+ * k x k matrix T of thick restart Lanczos, which is tridiagonal except for
+ * an arrowhead row/column at trlen [T(trlen, 0:trlen-1)]
+ *
+ * The arrowhead part is reduced only once after each restart [the caller
+ * needs to reset ws->reduced at each restart]. The tridiagonal matrix is
+ * solved by DSTEMR with range 'V'.
+ *
+ * @param k       dimension of T
+ * @param trlen   size of the thick restart part, 0 if T is tridiagonal
+ * @param T       the matrix T with leading dimension ldt
+ * @param vl      lower bound of the wanted eigenvalues
+ * @param[out] nevO   number of eigenvalues found in (vl, +inf)
+ * @param[out] lam    eigenvalues in ascending order
+ * @param[out] Q      eigenvectors with leading dimension ldq
+ * @param ws      work space allocated by alloc_treig
+ * @return the flag returned by DSTEMR
+ **/
+int ArrowTridEig(int k, int trlen, double *T, int ldt, double vl, int *nevO,
+                 double *lam, double *Q, int ldq, trEigWork *ws) {
+  char jobz = 'V', range = 'V', cN = 'N';
+  int j, m = 0, il = 1, iu = 1, info = 0, t1 = trlen+1;
+  double done = 1.0, dzero = 0.0, r, vu;
+  double *d = ws->d, *e = ws->e;
+  logical tryrac = 1;
+  /*-------------------- the tridiagonal matrix in d and e */
+  info = ArrowTridForm(k, trlen, T, ldt, ws);
+  if (info) {
+    return info;
+  }
+  /*-------------------- vu: Gershgorin upper bound */
+  vu = d[0];
+  for (j=0; j<k; j++) {
+    r = (j > 0 ? fabs(e[j-1]) : 0.0) + (j < k-1 ? fabs(e[j]) : 0.0);
+    vu = max(vu, d[j]+r);
+  }
+  vu += 1.0 + fabs(vu);
+  if (vu <= vl) {
+    *nevO = 0;
+    return 0;
+  }
+  DSTEMR(&jobz, &range, &k, d, e, &vl, &vu, &il, &iu, &m, lam, Q, &ldq, &k,
+         ws->isuppz, &tryrac, ws->work, &ws->lwork, ws->iwork, &ws->liwork,
+         &info);
+  if (info) {
+    printf("dstemr_ error %d\n", info);
+    m = 0;
+  }
+  /*-------------------- Q(0:trlen,:) = Qa * Q(0:trlen,:) */
+  if (trlen > 0 && m > 0) {
+    for (j=0; j<m; j++) {
+      memcpy(ws->Z+j*t1, Q+j*ldq, t1*sizeof(double));
+    }
+    DGEMM(&cN, &cN, &t1, &m, &t1, &done, ws->Qa, &t1, ws->Z, &t1, &dzero,
+          Q, &ldq);
+  }
+  *nevO = m;
+  return info;
+}
+
+/**
+ * @brief Compute all the eigenvalues of the k x k thick restart matrix T and
+ * only the last components of the associated (normalized) eigenvectors, i.e.,
+ * the bottom row of the eigenvector matrix, which is all that is needed for
+ * the residual norms of the Ritz pairs
+ *
+ * This is the implicit QL algorithm [as in Golub-Welsch, gausq2] in which the
+ * rotations are applied to one row only, so the cost is O(k^2)
+ *
+ * @param k       dimension of T
+ * @param trlen   size of the thick restart part, 0 if T is tridiagonal
+ * @param T       the matrix T with leading dimension ldt
+ * @param[out] lam  all eigenvalues in ascending order
+ * @param[out] zb   last components of the eigenvectors
+ * @param ws      work space allocated by alloc_treig
+ * @return 0 on success, > 0 if QL failed to converge for an eigenvalue
+ **/
+int ArrowTridEigBot(int k, int trlen, double *T, int ldt, double *lam,
+                    double *zb, trEigWork *ws) {
+  int i, j, l, m, it, info, t1 = trlen+1;
+  double b, c, f, g, p, r, s;
+  double *d = lam, *e = ws->e;
+  /*-------------------- the tridiagonal matrix in d and e */
+  info = ArrowTridForm(k, trlen, T, ldt, ws);
+  if (info) {
+    return info;
+  }
+  memcpy(d, ws->d, k*sizeof(double));
+  e[k-1] = 0.0;
+  /*-------------------- the row of the basis change for row k-1 of T */
+  for (j=0; j<k; j++) {
+    zb[j] = 0.0;
+  }
+  if (trlen > 0 && k-1 <= trlen) {
+    for (j=0; j<t1; j++) {
+      zb[j] = ws->Qa[j*t1+k-1];
+    }
+  } else {
+    zb[k-1] = 1.0;
+  }
+  /*-------------------- implicit QL */
+  for (l=0; l<k; l++) {
+    it = 0;
+    while (1) {
+      /*-------------------- look for a small sub-diagonal element */
+      for (m=l; m<k-1; m++) {
+        if (fabs(e[m]) <= DBL_EPSILON * (fabs(d[m]) + fabs(d[m+1]))) {
+          break;
+        }
+      }
+      p = d[l];
+      if (m == l) {
+        break;
+      }
+      if (it == 30) {
+        printf("ArrowTridEigBot: no convergence for eigenvalue %d\n", l);
+        return l+1;
+      }
+      it++;
+      /*-------------------- form shift */
+      g = (d[l+1] - p) / (2.0 * e[l]);
+      r = sqrt(g*g + 1.0);
+      g = d[m] - p + e[l] / (g + (g >= 0.0 ? r : -r));
+      s = 1.0;
+      c = 1.0;
+      p = 0.0;
+      for (i=m-1; i>=l; i--) {
+        f = s * e[i];
+        b = c * e[i];
+        if (fabs(f) >= fabs(g)) {
+          c = g / f;
+          r = sqrt(c*c + 1.0);
+          e[i+1] = f * r;
+          s = 1.0 / r;
+          c *= s;
+        } else {
+          s = f / g;
+          r = sqrt(s*s + 1.0);
+          e[i+1] = g * r;
+          c = 1.0 / r;
+          s *= c;
+        }
+        g = d[i+1] - p;
+        r = (d[i] - g) * s + 2.0 * c * b;
+        p = s * r;
+        d[i+1] = g + p;
+        g = c * r - b;
+        /*-------------------- apply the rotation to the row */
+        f = zb[i+1];
+        zb[i+1] = s * zb[i] + c * f;
+        zb[i] = c * zb[i] - s * f;
+      }
+      d[l] -= p;
+      e[l] = g;
+      e[m] = 0.0;
+    }
+  }
+  /*-------------------- sort eigenvalues [and zb] in ascending order */
+  for (i=0; i<k-1; i++) {
+    m = i;
+    for (j=i+1; j<k; j++) {
+      if (d[j] < d[m]) {
+        m = j;
+      }
+    }
+    if (m != i) {
+      p = d[i];  d[i] = d[m];  d[m] = p;
+      p = zb[i]; zb[i] = zb[m]; zb[m] = p;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Compute V(:,1:m) = V(:,1:k) * Q(:,1:m) in place, m <= k
+ *
+ * This is done by blocks of rows of V, so only a buffer of size nb x m is 
+ * needed instead of another n x m matrix. Columns k+1, ... of V are untouched
+ *
+ * @param n      number of rows of V [leading dimension of V]
+ * @param k      number of columns of V used
+ * @param m      number of columns of the result
+ * @param V      the n x k matrix, overwritten by the result in V(:,1:m)
+ * @param Q      the k x m matrix with leading dimension ldq
+ * @param work   work array of size lwork [lwork >= m]
+ **/
+void RitzVecsInPlace(int n, int k, int m, double *V, double *Q, int ldq,
+                     double *work, int lwork) {
+  char cN = 'N';
+  int i, j, nb;
+  double done = 1.0, dzero = 0.0;
+  if (m <= 0) {
+    return;
+  }
+  /*-------------------- number of rows in a block */
+  nb = min(n, lwork / m);
+  CHKERR(nb < 1);
+  for (i=0; i<n; i+=nb) {
+    int ib = min(nb, n-i);
+    /*-------------------- work = V(i:i+ib-1, 1:k) * Q(:,1:m) */
+    DGEMM(&cN, &cN, &ib, &m, &k, &done, V+i, &n, Q, &ldq, &dzero, work, &ib);
+    /*-------------------- V(i:i+ib-1, 1:m) = work */
+    for (j=0; j<m; j++) {
+      memcpy(V+j*n+i, work+j*ib, ib*sizeof(double));
+    }
+  }
+}
+
 /**
  * @brief Classical GS reortho with Daniel, Gragg, Kaufman, Stewart test
  **/
@@ -335,6 +335,102 @@ int scaleweigthts(int n, double a, double b, complex double *zk, int* mulp,
 }
 
 
+/* largest number of poles and multiplicity tried by ratf_opt_poles */
+#define RATF_OPT_NMAX 12
+#define RATF_OPT_PWMAX 4
+/* number of points on each side where the gap ratio is sampled */
+#define RATF_OPT_NPTS 200
+
+/**
+ * @brief Gap ratio of the filter with n poles of multiplicity pw on the
+ * reference interval [-1, 1]: max |r(x)| / bar for |x| >= 1+gap, sampled
+ * at RATF_OPT_NPTS points x = +-(1 + gap*s^k), geometric up to 1e3
+ */
+static double ratf_gapratio(int n, int pw, int method, double beta,
+                            double gap, double bar) {
+  int i, *mulp;
+  complex double *zk, *omega;
+  double *x, *r, s, q = 0.0;
+  Malloc(mulp, n, int);
+  Malloc(zk, n, complex double);
+  Malloc(omega, n*pw, complex double);
+  Malloc(x, 2*RATF_OPT_NPTS, double);
+  Malloc(r, 2*RATF_OPT_NPTS, double);
+  for (i=0; i<n; i++) {
+    mulp[i] = pw;
+  }
+  contQuad(method, n, zk);
+  weights(n, zk, mulp, beta, omega);
+  s = pow(1e3 / gap, 1.0 / (RATF_OPT_NPTS - 1));
+  x[0] = 1.0 + gap;
+  x[RATF_OPT_NPTS] = -x[0];
+  for (i=1; i<RATF_OPT_NPTS; i++) {
+    x[i] = 1.0 + (x[i-1] - 1.0) * s;
+    x[RATF_OPT_NPTS+i] = -x[i];
+  }
+  ratf2p2(n, mulp, zk, omega, 2*RATF_OPT_NPTS, x, r);
+  for (i=0; i<2*RATF_OPT_NPTS; i++) {
+    q = max(q, fabs(r[i]));
+  }
+  free(mulp);
+  free(zk);
+  free(omega);
+  free(x);
+  free(r);
+  return q / bar;
+}
+
+/**
+ * @brief Choose the number of poles and their multiplicity [rat->num,
+ * rat->pw] of the least cost among the filters that meet the target gap
+ * ratio rat->gapratio. The cost of a filter with num poles of
+ * multiplicity pw is
+ *   num * costfact + napply * num * pw
+ * (num factorizations, and num*pw solves for each of the napply
+ * applications of the filter), in units of one solve
+ * @return 0 if the target is met, 1 if not (the filter with the smallest
+ * gap ratio is used)
+ */
+static int ratf_opt_poles(ratparams *rat) {
+  int n, pw, pwmax, nbest = -1, pwbest = 1, n0 = 1, pw0 = 1, err = 0;
+  double q, cost, best = 0.0, q0 = 0.0, qbest = 0.0;
+  /*-------------------- multi-shift COCG: poles of multiplicity 1 */
+  pwmax = rat->defsolver == RATF_SOLVER_MSHIFT ? 1 : RATF_OPT_PWMAX;
+  for (n=1; n<=RATF_OPT_NMAX; n++) {
+    for (pw=1; pw<=pwmax; pw++) {
+      q = ratf_gapratio(n, pw, rat->method, rat->beta, rat->gap, rat->bar);
+      cost = n * rat->costfact + (double) rat->napply * n * pw;
+      /*-------------------- the best filter, if none meets the target */
+      if ((n == 1 && pw == 1) || q < q0) {
+        q0 = q;
+        n0 = n;
+        pw0 = pw;
+      }
+      if (q <= rat->gapratio && (nbest < 0 || cost < best)) {
+        best = cost;
+        qbest = q;
+        nbest = n;
+        pwbest = pw;
+      }
+    }
+  }
+  if (nbest < 0) {
+    printf("warning: no rational filter meets the gap ratio %.2e, ",
+           rat->gapratio);
+    printf("best is %.2e\n", q0);
+    nbest = n0;
+    pwbest = pw0;
+    qbest = q0;
+    err = 1;
+  }
+  rat->num = nbest;
+  rat->pw = pwbest;
+  printf("find_ratf: %d poles of multiplicity %d, gap ratio %.2e, "
+         "cost %.0f solves\n", nbest, pwbest, qbest,
+         nbest * rat->costfact + (double) rat->napply * nbest * pwbest);
+  return err;
+}
+
 /**
  * @brief Sets default values for ratparams struct
  * */
@@ -347,6 +443,22 @@ void set_ratf_def(ratparams *rat) {
   rat->bar  = 0.5;         // this is fixed for rational filter  
   rat->aa =  -1.0;         // left endpoint of interval
   rat->bb = 1.0;           // right endpoint of interval 
+#ifdef EVSL_WITH_SUITESPARSE
+  rat->defsolver = RATF_SOLVER_UMFPACK; // default solver: UMFPACK
+#else
+  rat->defsolver = RATF_SOLVER_LDL;     // default solver: built-in LDL^T
+#endif
+  rat->realform = 0;       // UMFPACK: complex factorization
+  rat->soltol = 0.0;       // tol. of iterative solver: from Lanczos tol
+  rat->membudget = 0;      // no memory budget for the factors
+  rat->memplan = 0;
+  rat->nincore = 0;
+  rat->factbytes = 0;
+  rat->optpoles = 0;       // num and pw are given
+  rat->gap = 0.3;          // gap for optpoles: 30% of the half-width
+  rat->gapratio = 0.1;     // target |r| / bar beyond the gap
+  rat->costfact = 20.0;    // cost of a factorization (in solves)
+  rat->napply = 200;       // expected number of filter applications
   //rat->cc = 0.0;           // center of interval
   //rat->dd = 1.0;           // width of interval
 }
@@ -357,6 +469,9 @@ void set_ratf_def(ratparams *rat) {
  *         [intv[2], intv[3]] is the global interval of all eigenvalues
  *         it must contain all eigenvalues of A
  *  
+ * With rat->optpoles set, rat->num and rat->pw are first chosen by
+ * ratf_opt_poles from the target gap ratio and the cost model in rat
+ *
  * OUT:
  * @param[out] rat
  * these are set in rat struct:\n
@@ -372,8 +487,14 @@ int find_ratf(double *intv, ratparams *rat) {
   complex double *omega; // weights of the poles
   complex double *zk;    // location of the poles
   int *mulp;             // multiplicity of the each pole
-  int n = rat->num, i, pow = 0, pw = rat->pw, method = rat->method;
+  int n, i, pow = 0, pw, method = rat->method;
   double beta = rat->beta;
+  /*-------------------- choose the number of poles and multiplicity */
+  if (rat->optpoles) {
+    ratf_opt_poles(rat);
+  }
+  n = rat->num;
+  pw = rat->pw;
   /*-------------------- A few parameters to be set or reset */
   Malloc(mulp, n, int);
   Malloc(zk, n, complex double);
@@ -413,6 +534,8 @@ int find_ratf(double *intv, ratparams *rat) {
   scaleweigthts(n, aa, bb, zk, mulp, omega);
     
   rat->solshift = NULL;
+  rat->solshiftblk = NULL;
+  rat->solshiftz = NULL;
   rat->solshiftdata = NULL;
 
   return 0;
@@ -423,20 +546,46 @@ int set_ratf_solfunc(ratparams *rat, csrMat *A, linSolFunc *funcs, void **data)
   /* (re)allocate enough space (number of poles) */
   Realloc(rat->solshift, rat->num, linSolFunc);
   Realloc(rat->solshiftdata, rat->num, void *);
-  /* if funcs are not provided, use the default sovler: UMFPACK */
+  Realloc(rat->solshiftblk, rat->num, linSolFuncBlock);
+  Realloc(rat->solshiftz, rat->num, linSolFuncZ);
+  /* if funcs are not provided, use the default sovler: UMFPACK, the
+   * built-in complex symmetric LDL^T or the iterative solver COCG */
   if (funcs == NULL) {
 #ifdef EVSL_WITH_SUITESPARSE
-    rat->use_default_solver = 1;
-    err = set_ratf_solfunc_default(A, rat);
+    if (rat->defsolver == RATF_SOLVER_UMFPACK) {
+      rat->use_default_solver = RATF_SOLVER_UMFPACK;
+      return set_ratf_solfunc_default(A, rat);
+    }
 #else
-    printf("error: EVSL was not compiled with the default solver, ");
-    printf("so the users must provide solvers\n");
-    err = -1;
+    if (rat->defsolver == RATF_SOLVER_UMFPACK) {
+      printf("warning: UMFPACK is not available [no SuiteSparse], ");
+      printf("using LDL^T\n");
+    }
 #endif
+    if (rat->defsolver == RATF_SOLVER_COCG ||
+        rat->defsolver == RATF_SOLVER_MSHIFT) {
+      err = set_ratf_solfunc_iter(rat, A, NULL, NULL);
+      /* one Krylov space for all the poles: only with multiplicity 1 */
+      if (rat->defsolver == RATF_SOLVER_MSHIFT && !err) {
+        if (rat->pow == rat->num) {
+          rat->use_default_solver = RATF_SOLVER_MSHIFT;
+        } else {
+          printf("warning: multi-shift COCG needs poles of multiplicity 1, ");
+          printf("using COCG for each pole\n");
+        }
+      }
+      return err;
+    }
+    rat->use_default_solver = RATF_SOLVER_LDL;
+    err = set_ratf_solfunc_ldl(A, rat);
     return err;
   }
   /* if funcs are provided, copy the function pointers and data */
-  rat->use_default_solver = 0;
+  rat->use_default_solver = RATF_SOLVER_USER;
+  free(rat->solshiftblk);
+  rat->solshiftblk = NULL;
+  free(rat->solshiftz);
+  rat->solshiftz = NULL;
   for (i=0; i<rat->num; i++) {
     rat->solshift[i] = funcs[i];
     rat->solshiftdata[i] = data ? data[i] : NULL;
@@ -444,14 +593,61 @@ int set_ratf_solfunc(ratparams *rat, csrMat *A, linSolFunc *funcs, void **data)
   return 0;
 }
 
+/**
+ * @brief Set the multiple right-hand side solvers of the poles [optional],
+ * used by the block rational filter. They are called with the same data
+ * as the solvers set by set_ratf_solfunc, which must be called first.
+ * A NULL entry of funcs means the pole's single right-hand side solver
+ * is applied to one column at a time
+ */
+int set_ratf_solfunc_block(ratparams *rat, linSolFuncBlock *funcs) {
+  int i;
+  if (rat->solshift == NULL) {
+    printf("error: set_ratf_solfunc must be called first\n");
+    return -1;
+  }
+  Realloc(rat->solshiftblk, rat->num, linSolFuncBlock);
+  for (i=0; i<rat->num; i++) {
+    rat->solshiftblk[i] = funcs ? funcs[i] : NULL;
+  }
+  return 0;
+}
+
+/**
+ * @brief Set the solvers of the poles with interleaved complex vectors
+ * [optional], used by RatFiltApply when available. They are called with
+ * the same data as the solvers set by set_ratf_solfunc, which must be
+ * called first. A NULL entry of funcs means the split (real/imag) solver
+ * of the pole is used
+ */
+int set_ratf_solfunc_z(ratparams *rat, linSolFuncZ *funcs) {
+  int i;
+  if (rat->solshift == NULL) {
+    printf("error: set_ratf_solfunc must be called first\n");
+    return -1;
+  }
+  Realloc(rat->solshiftz, rat->num, linSolFuncZ);
+  for (i=0; i<rat->num; i++) {
+    rat->solshiftz[i] = funcs ? funcs[i] : NULL;
+  }
+  return 0;
+}
+
 void free_rat(ratparams *rat) {
   free(rat->mulp);
   free(rat->omega);
   free(rat->zk);
   free(rat->solshift);
+  free(rat->solshiftblk);
+  free(rat->solshiftz);
 #ifdef EVSL_WITH_SUITESPARSE
   free_rat_default_sol(rat);
 #endif
+  if (rat->use_default_solver == RATF_SOLVER_LDL) {
+    free_rat_ldl_sol(rat);
+  } else if (rat->use_default_solver >= RATF_SOLVER_COCG) {
+    free_rat_iter_sol(rat);
+  }
   free(rat->solshiftdata);
 }
 
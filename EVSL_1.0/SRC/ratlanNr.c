@@ -4,6 +4,9 @@
 #include <string.h>
 #include <float.h>
 #include <complex.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "def.h"
 #include "blaslapack.h"
 #include "struct.h"
@@ -88,6 +91,8 @@ int RatLanNr(csrMat *A, double *intv, ratparams *rat, int maxit, double tol,
   double aa = intv[0];
   double bb = intv[1];
   int deg = rat->pow; // multiplicity of the pole
+  /*-------------------- accuracy of the iterative shifted solves */
+  ratf_set_soltol(rat, tol);
   /*-----------------------------------------------------------------------* 
    * *Non-restarted* Lanczos iteration 
    *-----------------------------------------------------------------------*/
@@ -123,7 +128,8 @@ int RatLanNr(csrMat *A, double *intv, ratparams *rat, int maxit, double tol,
   DSCAL(&n, &t, V, &one);
   /*-------------------- u  is just a pointer. wk == work space */
   double *u, *wk, *w3;
-  Malloc(wk, 4*n, double);
+  /*   4*n for each thread in RatFiltApply */
+  Malloc(wk, 4*n*RatFiltNthreads(rat), double);
   w3 = wk;
   //Malloc(w3, 3*n, double);  // work space for solving complex system
   /*-------------------- for ortho test */
@@ -284,6 +290,9 @@ int RatLanNr(csrMat *A, double *intv, ratparams *rat, int maxit, double tol,
   if (do_print){
     fprintf(fstats, "------This slice consumed: \n");
     fprintf(fstats, "# of solves :        %d\n", nsv);
+    if (rat->use_default_solver >= RATF_SOLVER_COCG) {
+      fprintf(fstats, "# of COCG its :      %d\n", ratf_iter_count(rat));
+    }
     fprintf(fstats, "# of Matvec :        %d\n", nmv);
     fprintf(fstats, "total time  :        %.2f\n", tall);
     fprintf(fstats, "solve time  :        %.2f\n", tmv);
@@ -292,50 +301,199 @@ int RatLanNr(csrMat *A, double *intv, ratparams *rat, int maxit, double tol,
   return 0;
 }
 
+/**
+ * @brief Number of threads that process the poles in RatFiltApply and
+ * RatFiltApplyBlock: min(rat->num, omp_get_max_threads()), 1 without OpenMP
+ *
+ * The work arrays of RatFiltApply and RatFiltApplyBlock have one part per
+ * thread, so the caller sizes them with this number
+ * */
+int RatFiltNthreads(ratparams *rat) {
+#ifdef _OPENMP
+  return max(1, min(rat->num, omp_get_max_threads()));
+#else
+  return 1;
+#endif
+}
+
 /**
  * @brief Apply rational filter R to a vetor b
  *
- * @param w4 Work array of size 4*n
+ * The poles are independent of each other until the final sum, so they
+ * are processed in parallel [OpenMP], each thread with its own part of the
+ * work space. The contributions of the poles are added to x in the order
+ * of the poles, so the result does not depend on the number of threads,
+ * provided that the
+ * solvers follow the thread safety rule of ratparams [as the built-in
+ * ones do]. With the multi-shift solver [RATF_SOLVER_MSHIFT], all
+ * the poles are solved in one Krylov space instead
+ * [ratf_multishift_apply]. The solvers with
+ * interleaved complex vectors [rat->solshiftz] are used when available
+ *
+ * @param w Work array of size 4*n*RatFiltNthreads(rat) [4*n per thread]
  *
  * @param[out] x Becomes R(A)b
  * */
-void RatFiltApply(int n, ratparams *rat, double *b, double *x, double *w4) {
-  int ii, jj, kk, k=0, kf;
+void RatFiltApply(int n, ratparams *rat, double *b, double *x, double *w) {
+  int kk, one = 1;
   int *mulp = rat->mulp;
   int num = rat->num;
   complex double *omega = rat->omega;
-  
-  double *xr, *xz, *bz, *br;
-  double zkr, zkc;
-  xr = w4;
-  xz = xr + n;
-  bz = xz + n;
-  br = bz + n;
-  for (ii=0; ii<n; ii++){
-    x[ii] = 0.0;
+  double two = 2.0;
+  /* multi-shift solver: all the poles at once */
+  if (rat->use_default_solver == RATF_SOLVER_MSHIFT) {
+    ratf_multishift_apply(n, rat, b, x);
+    return;
   }
+  memset(x, 0, n*sizeof(double));
   /* loop through each pole */
+#ifdef _OPENMP
+#pragma omp parallel for ordered schedule(dynamic) num_threads(RatFiltNthreads(rat))
+#endif
   for (kk=0; kk<num; kk++) {
-    //make sure br bz are zero vectors of size n
-    for (ii=0; ii<n; ii++){
-      xr[ii] = xz[ii] = 0.0;
+    int ii, jj, k, kf, inc = 1;
+    double *xr, *xz, *bz, *br;
+    double zkr, zkc;
+    linSolFuncZ solz = rat->solshiftz ? rat->solshiftz[kk] : NULL;
+    /* work space of this thread */
+#ifdef _OPENMP
+    xr = w + 4*n*omp_get_thread_num();
+#else
+    xr = w;
+#endif
+    /* omega[k : kf-1] are the weights of this pole */
+    k = 0;
+    for (ii=0; ii<kk; ii++) {
+      k += mulp[ii];
+    }
+    kf = k + mulp[kk];
+    if (solz) {
+      /* interleaved complex vectors: x and the right-hand side bc */
+      complex double *xc = (complex double *) xr;
+      complex double *bc = xc + n;
+      for(jj=kf-1; jj>=k; jj--) { // power loop
+        complex double om = omega[jj];
+        // x = 0 before the first solve
+        if (jj == kf-1) {
+          for(ii=0; ii<n; ii++) {
+            bc[ii] = om*b[ii];
+          }
+        } else {
+          for(ii=0; ii<n; ii++) {
+            bc[ii] = om*b[ii] + xc[ii];
+          }
+        }
+        solz(n, bc, xc, rat->solshiftdata[kk]);
+      }
+      /* the real parts are strided with the interleaved complex vectors */
+      inc = 2;
+    } else {
+      xz = xr + n;
+      bz = xz + n;
+      br = bz + n;
+      for(jj=kf-1; jj>=k; jj--) { // power loop
+        zkr = creal(omega[jj]);
+        zkc = cimag(omega[jj]);
+        //Initilize the right hand side [x = 0 before the first solve]
+        if (jj == kf-1) {
+          for(ii=0; ii<n; ii++) {
+            br[ii] = zkr*b[ii];
+            bz[ii] = zkc*b[ii];
+          }
+        } else {
+          for(ii=0; ii<n; ii++) {
+            br[ii] = zkr*b[ii] + xr[ii];
+            bz[ii] = zkc*b[ii] + xz[ii];
+          }
+        }
+        // Solve (Ax+Az*1I)(xr+xz*1I) = (br+bz*1I)
+        (rat->solshift[kk])(n, br, bz, xr, xz, rat->solshiftdata[kk]);
+      }
+    }
+    /* x += 2*xr, in the order of the poles */
+#ifdef _OPENMP
+#pragma omp ordered
+#endif
+    DAXPY(&n, &two, xr, &inc, x, &one);
+  }
+}
+
+/**
+ * @brief Apply rational filter R to the p columns of an n x p block B
+ *
+ * Same as RatFiltApply, but the p right-hand sides of each shifted system
+ * are solved at once by the multiple right-hand side solver of the pole
+ * [rat->solshiftblk] if it is available, or one column at a time otherwise
+ *
+ * @param w Work array of size 4*n*p*RatFiltNthreads(rat) [4*n*p per
+ * thread]
+ *
+ * @param[out] X Becomes R(A)B [n x p]
+ * */
+void RatFiltApplyBlock(int n, int p, ratparams *rat, double *B, double *X,
+                       double *w) {
+  int kk, one = 1, np = n*p;
+  int *mulp = rat->mulp;
+  int num = rat->num;
+  complex double *omega = rat->omega;
+  double two = 2.0;
+  /* multi-shift solver: all the poles at once, one column at a time */
+  if (rat->use_default_solver == RATF_SOLVER_MSHIFT) {
+    for (kk=0; kk<p; kk++) {
+      ratf_multishift_apply(n, rat, B+kk*n, X+kk*n);
+    }
+    return;
+  }
+  memset(X, 0, np*sizeof(double));
+  /* loop through each pole */
+#ifdef _OPENMP
+#pragma omp parallel for ordered schedule(dynamic) num_threads(RatFiltNthreads(rat))
+#endif
+  for (kk=0; kk<num; kk++) {
+    int ii, jj, k, kf, r;
+    double *xr, *xz, *bz, *br;
+    double zkr, zkc;
+    linSolFuncBlock solblk = rat->solshiftblk ? rat->solshiftblk[kk] : NULL;
+    /* work space of this thread */
+#ifdef _OPENMP
+    xr = w + 4*np*omp_get_thread_num();
+#else
+    xr = w;
+#endif
+    xz = xr + np;
+    bz = xz + np;
+    br = bz + np;
+    /* omega[k : kf-1] are the weights of this pole */
+    k = 0;
+    for (ii=0; ii<kk; ii++) {
+      k += mulp[ii];
     }
     kf = k + mulp[kk];
+    for (ii=0; ii<np; ii++){
+      xr[ii] = xz[ii] = 0.0;
+    }
     for(jj=kf-1; jj>=k; jj--) { // power loop
       zkr = creal(omega[jj]);
       zkc = cimag(omega[jj]);
-      //Initilize the right hand side
-      for(ii=0; ii<n; ii++) {
-        br[ii] = zkr*b[ii] + xr[ii];
-        bz[ii] = zkc*b[ii] + xz[ii];
+      //Initilize the right hand sides
+      for(ii=0; ii<np; ii++) {
+        br[ii] = zkr*B[ii] + xr[ii];
+        bz[ii] = zkc*B[ii] + xz[ii];
+      }
+      // Solve (Ax+Az*1I)(Xr+Xz*1I) = (Br+Bz*1I)
+      if (solblk) {
+        solblk(n, p, br, bz, xr, xz, rat->solshiftdata[kk]);
+      } else {
+        for (r=0; r<p; r++) {
+          (rat->solshift[kk])(n, br+r*n, bz+r*n, xr+r*n, xz+r*n,
+                              rat->solshiftdata[kk]);
+        }
       }
-      // Solve (Ax+Az*1I)(xr+xz*1I) = (br+bz*1I)
-      (rat->solshift[kk])(n, br, bz, xr, xz, rat->solshiftdata[kk]);
-    }
-    for(ii=0; ii<n; ii++) {
-      x[ii] = x[ii]+ 2*xr[ii];
     }
-    k = kf;
+    /* X += 2*Xr, in the order of the poles */
+#ifdef _OPENMP
+#pragma omp ordered
+#endif
+    DAXPY(&np, &two, xr, &one, X, &one);
   }
 }
-
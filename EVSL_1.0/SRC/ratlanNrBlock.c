@@ -0,0 +1,305 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <float.h>
+#include <complex.h>
+#include "def.h"
+#include "blaslapack.h"
+#include "struct.h"
+#include "internal_proto.h"
+
+/**
+ * @brief Classical GS reortho with DGKS test [as CGS_DGKS] that also
+ * returns the coefficients h = Q'*v of the projection (summed over the
+ * passes)
+ **/
+static void CGS_DGKS_coef(int n, int k, double *Q, double *v, double *h,
+                          double *nrmv, double *w) {
+  double eta = 1.0 / sqrt(2.0);
+  int i, j, one=1;
+  char cT = 'T', cN = 'N';
+  double done=1.0, dmone=-1.0, dzero=0.0;
+  double old_nrm = sqrt( DDOT(&n, v, &one, v, &one) );
+  double new_nrm = 0.0;
+  for (j=0; j<k; j++) {
+    h[j] = 0.0;
+  }
+  for (i=0; i<NGS_MAX; i++) {
+    DGEMV(&cT, &n, &k, &done,  Q, &n, v, &one, &dzero, w, &one);
+    DGEMV(&cN, &n, &k, &dmone, Q, &n, w, &one, &done,  v, &one);
+    for (j=0; j<k; j++) {
+      h[j] += w[j];
+    }
+    new_nrm = sqrt( DDOT(&n, v, &one, v, &one) );
+    if (new_nrm > eta * old_nrm) {
+      break;
+    }
+    old_nrm = new_nrm;
+  }
+  *nrmv = new_nrm;
+}
+
+/**
+ * @brief Residual norm of a Ritz pair of the filtered matrix in the block
+ * Lanczos process: norm(B_j * y(kdim-bs:kdim-1)), where B_j [bs x bs] is
+ * the last sub-diagonal block of T
+ **/
+static double BlkRitzRes(int kdim, int bs, double *T, int ldt, double *y) {
+  int r, c;
+  double s, t = 0.0;
+  for (r=0; r<bs; r++) {
+    s = 0.0;
+    for (c=0; c<bs; c++) {
+      s += T[(kdim+r) + (kdim-bs+c)*ldt] * y[kdim-bs+c];
+    }
+    t += s*s;
+  }
+  return sqrt(t);
+}
+
+/**-----------------------------------------------------------------------
+ *  @brief Block rational filtering Lanczos process [NON-restarted version]
+ *
+ *  Same as RatLanNr, but bs Lanczos vectors are filtered at a time, so the
+ *  shifted systems of each pole are solved with bs right-hand sides at
+ *  once [see RatFiltApplyBlock]. The projected matrix T is block
+ *  tridiagonal (banded, with bandwidth bs)
+ *
+ *  @param A      matrix of size n x n
+ *  @param intv   an array of length 4
+ *          [intv[0], intv[1]] is the interval of desired eigenvalues
+ *          [intv[2], intv[3]] is the global interval of all eigenvalues
+ *          it must contain all eigenvalues of A
+ *  @param rat    the rational filter and the solvers of the poles
+ *  @param bs     block size
+ *  @param maxit  max dimension of the Krylov subspace [rounded down to a
+ *          multiple of bs]
+ *  @param tol    tolerance for convergence [see RatLanNr]
+ *  @param vinit  initial block for Lanczos [n x bs matrix]
+ *
+ *  @param[out] nevOut   Number of eigenvalues/vectors computed
+ *  @param[out] Wo       A set of eigenvectors  [n x nevOut matrix]
+ *  @param[out] lamo     Associated eigenvalues [nevOut x 1 vector]
+ *  @param[out] reso     Associated residual norms [nev x 1 vector]
+ *  @param[out] fstats   File stream which stats are printed to
+ *
+ * ------------------------------------------------------------ */
+int RatLanNrBlock(csrMat *A, double *intv, ratparams *rat, int bs,
+                  int maxit, double tol, double *vinit, int *nevOut,
+                  double **lamo, double **Wo, double **reso, FILE *fstats) {
+  /*-------------------- for stats */
+  double tm,  tmv=0.0, tr0, tr1, tall;
+  double *y, flami;
+  //-------------------- to report timings/
+  tall = cheblan_timer();
+  int i, j, c, kdim = 0, nblk, mdim, ldT;
+  // handle case where fstats is NULL. Then no output. Needed for openMP.
+  int do_print = 1;
+  if (fstats == NULL){
+    do_print = 0;
+  }
+  /*--------------------   frequently used constants  */
+  char cN = 'N';
+  int one = 1;
+  double done=1.0,dzero=0.0;
+  /*--------------------   Ntest = when to start testing convergence */
+  int Ntest = 30;
+  /*--------------------   how often to test [in blocks] */
+  int cycle = max(1, 20/bs);
+  /* size of the matrix */
+  int n;
+  /* if users provided their own matvec function, input matrix A will be ignored */
+  if (evsldata.Amatvec.func) {
+    n = evsldata.Amatvec.n;
+  } else {
+    n = A->nrows;
+  }
+  bs = max(1, min(bs, n));
+  maxit = min(n, maxit);
+  nblk = max(1, maxit / bs);
+  mdim = nblk * bs;
+  ldT = mdim + bs;
+  /*-------------------- a, b, used for testing only at end */
+  double  bar = 0.5;
+  if (check_intv(intv, fstats) < 0) {
+    *nevOut = 0;
+    *lamo = NULL; *Wo = NULL; *reso = NULL;
+    return 0;
+  }
+  double aa = intv[0];
+  double bb = intv[1];
+  int deg = rat->pow; // multiplicity of the pole
+  /*-------------------- accuracy of the iterative shifted solves */
+  ratf_set_soltol(rat, tol);
+  /*-----------------------------------------------------------------------*
+   * *Non-restarted* block Lanczos iteration
+   *-----------------------------------------------------------------------*/
+  if (do_print)
+    fprintf(fstats, " ** Rat-LanNr-Block, block size %d \n", bs);
+  /*-------------------- Lanczos vectors V and block tridiagonal matrix T */
+  double *V, *T, *h;
+  Malloc(V, n*ldT, double);
+  Calloc(T, ldT*ldT, double);
+  Malloc(h, ldT, double);
+  double *W, *Lam, *res, *EvalT, *EvecT;
+  Malloc(EvalT, mdim, double);       // eigenvalues of T
+  Malloc(EvecT, mdim*mdim, double);  // Eigen vectors of T
+  /*-------------------- nconv = converged eigenpairs from looking at T alone */
+  int nev, nconv = 0, nconv0 = -1;
+  /*-------------------- nmv counts  matvecs */
+  int nmv = 0;
+  /*-------------------- nsv counts  solves */
+  int nsv = 0;
+  /*-------------------- work space: 4*n*bs for each thread in RatFiltApplyBlock */
+  double *wk;
+  Malloc(wk, max(4*n*bs*RatFiltNthreads(rat), ldT), double);
+  /*-------------------- orthonormal initial block V(:,1:bs) */
+  orth(vinit, n, bs, V, wk);
+  /*-------------------- for ortho test */
+  double wn = 0.0;
+  int nwn = 0;
+  /*-------------------- for stopping test [restricted trace]*/
+  tr0 = 0;
+  double t, t1, t2, nt, res0, beta, resi;
+  // ---------------- main block Lanczos loop
+  for (j=0; j<nblk; j++) {
+    /*-------------------- V_j = V(:,j*bs:(j+1)*bs-1) and the next block */
+    double *Vj = V + j*bs*n;
+    double *Wj = Vj + bs*n;
+    /*-------------------- W_j = R(A) * V_j */
+    tm = cheblan_timer();
+    RatFiltApplyBlock(n, bs, rat, Vj, Wj, wk);
+    tmv += cheblan_timer() - tm;
+    nsv += deg*bs;
+    /*-------------------- FULL reortho of W_j against all previous Lanczos
+     *                     vectors and QR of W_j, column by column. The
+     *                     coefficients give the new columns of T */
+    for (c=0; c<bs; c++) {
+      int col = j*bs + c;
+      int kk = (j+1)*bs + c;
+      double *w = Wj + c*n;
+      CGS_DGKS_coef(n, kk, V, w, h, &beta, wk);
+      for (i=j*bs; i<kk; i++) {
+        T[i+col*ldT] = T[col+i*ldT] = h[i];
+      }
+      wn += fabs(h[col]) + 2.0 * beta;
+      nwn += 3;
+      /*-------------------- (lucky) breakdown test */
+      if (beta*nwn < orthTol*wn) {
+        if (do_print)
+          fprintf(fstats, "it %4d: Lucky breakdown, beta = %.15e\n", col, beta);
+        rand_double(n, w);
+        CGS_DGKS(n, kk, NGS_MAX, V, w, &t, wk);
+        T[kk+col*ldT] = T[col+kk*ldT] = 0.0;
+        beta = t;
+      } else {
+        T[kk+col*ldT] = T[col+kk*ldT] = beta;
+      }
+      t = 1.0 / beta;
+      DSCAL(&n, &t, w, &one);
+    }
+    kdim = (j+1)*bs;
+    /*--------------------  test for Ritz vectors */
+    if ( (kdim < Ntest || j % cycle != 0) && j != nblk-1 ) {
+      continue;
+    }
+    /*--------------------   diagonalize  T(1:kdim,1:kdim) */
+    SymEigenSolver(kdim, T, ldT, EvecT, kdim, EvalT);
+    tr1 = 0;     // restricted trace -- used for convergence test
+    nconv = 0;
+    for (i=0; i<kdim; i++) {
+      flami = EvalT[i];
+      if (fabs(flami) >= bar) tr1+= flami;
+      if (BlkRitzRes(kdim, bs, T, ldT, &EvecT[i*kdim]) < tol) nconv++;
+    }
+    if (do_print) {
+      fprintf(fstats, "k %4d:   # sols %8d, nconv %4d  tr1 %21.15e\n",
+              kdim, nsv, nconv,tr1);
+    }
+    //-------------------- simple test because all eigenvalues
+    // are between gamB and ~1. A block adds bs vectors between two tests,
+    // so also wait until no more Ritz pairs converge
+    if (fabs(tr1-tr0)<tol*fabs(tr1) && nconv == nconv0) {
+      break;
+    }
+    tr0 = tr1;
+    nconv0 = nconv;
+  }
+
+  //-------------------- done == compute Ritz vectors --
+  int ncand = 0;
+  for (i=0; i<kdim; i++) {
+    if (fabs(EvalT[i]) >= bar &&
+        BlkRitzRes(kdim, bs, T, ldT, &EvecT[i*kdim]) <= tol) {
+      ncand++;
+    }
+  }
+  Malloc(W, ncand*n, double);       // holds computed Ritz vectors
+  Malloc(Lam, ncand, double);       // holds computed Ritz values
+  Malloc(res, ncand, double);       // holds residual norms (w.r.t. ro(A))
+  //
+  nev = 0;
+  for (i=0; i<kdim; i++) {
+    double *u;
+    flami = EvalT[i];
+    //-------------------- reject eigenvalue if rho(lam)<bar
+    if (fabs(flami) < bar)
+      continue;
+    y = &EvecT[i*kdim];
+    //-------------------- residual norm
+    resi = BlkRitzRes(kdim, bs, T, ldT, y);
+    if (resi > tol)
+      continue;
+    //-------------------- compute Ritz vectors.
+    u = &W[nev*n];
+    DGEMV(&cN, &n, &kdim, &done, V, &n, y, &one, &dzero, u, &one);
+    /*--------------------   w = A*u        */
+    matvec_genev(A, u, wk);
+    nmv ++;
+    /*--------------------   Ritzval: t = (y'*w)/(y'*y) */
+    t1 = DDOT(&n, u, &one, u, &one);  // should be one
+    t2 = DDOT(&n, wk, &one, u, &one);
+    t  = t2 / t1;
+    /*--------------------  if lambda (==t) is in [a,b] */
+    if (t < aa - DBL_EPSILON || t > bb + DBL_EPSILON)
+      continue;
+    /*-------------------- compute residual wrt A for this pair */
+    nt = -t;
+    /*-------------------- w = w - t*y */
+    DAXPY(&n, &nt, u, &one, wk, &one);
+    /*--------------------   res0 = norm(w) */
+    res0 = DNRM2(&n, wk, &one);
+    /*--------------------   accept (t, y) */
+    Lam[nev] = t;
+    res[nev] = res0;
+    nev++;
+  }
+  /*-------------------- Done.  output : */
+  *nevOut = nev;
+  *lamo = Lam;
+  *Wo = W;
+  *reso = res;
+  /*-------------------- free arrays */
+  free(V);
+  free(T);
+  free(h);
+  free(EvalT);
+  free(EvecT);
+  free(wk);
+  /*-------------------- record stats */
+  tall = cheblan_timer() - tall;
+  /*-------------------- print stat */
+  if (do_print){
+    fprintf(fstats, "------This slice consumed: \n");
+    fprintf(fstats, "# of solves :        %d\n", nsv);
+    if (rat->use_default_solver >= RATF_SOLVER_COCG) {
+      fprintf(fstats, "# of COCG its :      %d\n", ratf_iter_count(rat));
+    }
+    fprintf(fstats, "# of Matvec :        %d\n", nmv);
+    fprintf(fstats, "total time  :        %.2f\n", tall);
+    fprintf(fstats, "solve time  :        %.2f\n", tmv);
+    fprintf(fstats,"======================================================\n");
+  }
+  return 0;
+}
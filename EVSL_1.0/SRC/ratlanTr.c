@@ -79,7 +79,7 @@ int RatLanTr(csrMat *A, int lanm, int nev, double *intv, ratparams *rat,
   //char cT='T';
   char cN = 'N';
   int one = 1;
-  double done=1.0,dmone=-1.0,dzero=0.0;
+  double done=1.0,dmone=-1.0;
   /*--------------------   Ntest = when to start testing convergence */
   int Ntest = min(lanm, nev+50);
   /*--------------------   how often to test */
@@ -95,6 +95,8 @@ int RatLanTr(csrMat *A, int lanm, int nev, double *intv, ratparams *rat,
   double aa = intv[0];
   double bb = intv[1];
   double bar = 0.5; // for the scaled rational filter
+  /*-------------------- accuracy of the iterative shifted solves */
+  ratf_set_soltol(rat, tol);
   /*-----------------------------------------------------------------------* 
    * *thick restarted* Lanczos step 
    *-----------------------------------------------------------------------*/
@@ -125,13 +127,18 @@ res: related residual norms */
   /*-------------------- nsv counts  solves */
   int nsv = 0;
   /*-------------------- Ritz values and vectors of p(A) */
-  double *Rval, *Rvec, *resi;
+  double *Rval, *resi;
   Malloc(Rval, lanm, double);
   Malloc(resi, lanm, double);
-  Malloc(Rvec, n*lanm, double);
   /*-------------------- Eigen vectors of T */
   double *EvecT;
   Malloc(EvecT, lanm1*lanm1, double);
+  /*-------------------- work space for the eigen-decomposition of T,
+                         reused at each convergence test */
+  trEigWork treig;
+  alloc_treig(lanm1, &treig);
+  /*-------------------- nritz = number of Ritz values >= bar */
+  int nritz = 0;
   /*-------------------- s used by TR (spike of 1st block in Tm)*/
   double *s;
   Malloc(s, lanm, double);
@@ -143,7 +150,8 @@ res: related residual norms */
   DSCAL(&n, &t, V, &one);
   /*-------------------- alloc some work space */
   double *work, *w3;
-  int work_size = 4*n;
+  /*   4*n for each thread in RatFiltApply */
+  int work_size = 4*n*RatFiltNthreads(rat);
   Malloc(work, work_size, double);
   w3 = work;
   //Malloc(w3, 3*n, double);  // work space for solving complex system
@@ -282,23 +290,32 @@ res: related residual norms */
       /*-------------------- Restarting test */
       k1 = k-trlen-Ntest;
       if ( ((k1>=0) && (k1 % cycle == 0)) || (k == lanm) || it == maxit) {
-        /*--------------------   solve eigen-problem for T(1:k,1:k) */
-        /*                       vals in Rval, vecs in EvecT */
-        //printf("k %d, trlen %d, Ntest %d, its %d\n", k, trlen, Ntest, it);
-        SymEigenSolver(k, T, lanm1, EvecT, lanm1, Rval);
         /*-------------------- max dim reached-break from the inner loop */
         if (k == lanm || it == maxit) {
           break;
         }
+        /*--------------------   eigenvalues of T(1:k,1:k) in Rval and only
+                                 the bottom row of its eigenvectors in resi.
+                                 Eigenvectors are computed at restart */
+        if (ArrowTridEigBot(k, trlen, T, lanm1, Rval, resi, &treig)) {
+          /*-------------------- QL failed: vals >= bar and vecs by DSTEMR */
+          ArrowTridEig(k, trlen, T, lanm1, bar-DBL_EPSILON, &nritz, Rval,
+                       EvecT, lanm1, &treig);
+          for (i=0; i<nritz; i++) {
+            resi[i] = EvecT[i*lanm1+(k-1)];
+          }
+        } else {
+          nritz = k;
+        }
         count = 0;
         /*-------------------- get residual norms and check acceptance of
           Ritz values for R(A). */
         //--------------------count e.vals in interval + those that convergeed
         jl = 0;
-        for (i=0; i<k; i++) {
+        for (i=0; i<nritz; i++) {
           if (Rval[i]>= bar) {
             jl++;
-            r = fabs(beta*EvecT[i*lanm1+(k-1)]);
+            r = fabs(beta*resi[i]);
             resi[i] = r;
             if (r < tolP) {
               count++;
@@ -322,10 +339,18 @@ res: related residual norms */
       /*-------------------- end of inner (Lanczos) loop - Next: restart*/        
     }     //                 while (k<mlan) loop
 
+    /*--------------------   solve eigen-problem for T(1:k,1:k) */
+    /*                       vals >= bar in Rval, vecs in EvecT */
+    ArrowTridEig(k, trlen, T, lanm1, bar-DBL_EPSILON, &nritz, Rval, EvecT,
+                 lanm1, &treig);
+    /*--------------------   residual norms from the bottom row of EvecT */
+    for (i=0; i<nritz; i++) {
+      resi[i] = fabs(beta*EvecT[i*lanm1+(k-1)]);
+    }
     /*--------------------   TWO passes to select good candidates */
     /*                       Pass-1: based on if ``p(Ritzvalue) > bar'' */	    
     jl = 0;
-    for (i=0; i<k; i++) {
+    for (i=0; i<nritz; i++) {
       /*--------------------   if this Ritz value is higher than ``bar'' */
       if (Rval[i] >= bar) {
         // move good eigenvectors/vals to front
@@ -337,8 +362,9 @@ res: related residual norms */
         jl++;
       }
     }
-    /*   Compute the Ritz vectors: Rvec(:,1:jl) = V(:,1:k) * EvecT(:,1:jl) */
-    DGEMM(&cN,&cN,&n,&jl,&k,&done,V,&n,EvecT,&lanm1,&dzero,Rvec,&n);
+    /*   Compute the Ritz vectors in place: 
+         V(:,1:jl) = V(:,1:k) * EvecT(:,1:jl), V(:,k+1) is untouched */
+    RitzVecsInPlace(n, k, jl, V, EvecT, lanm1, work, work_size);
     /*--------------------  Pass-2: check if Ritz vals of A are in [a,b] */
     /*                      number of Ritz values in [a,b] */
     ll = 0;
@@ -346,7 +372,7 @@ res: related residual norms */
     prtrlen = trlen; 
     trlen = 0;
     for (i=0; i<jl; i++) {
-      double *y = Rvec + i*n;
+      double *y = V + i*n;
       double *w = work;
       /*--------------------   normalize just in case. */
       t = DNRM2(&n, y, &one); 
@@ -429,6 +455,8 @@ res: related residual norms */
     }
     /*-------------------- prepare to restart.  First zero out all T */
     memset(T, 0, lanm1*lanm1*sizeof(double));
+    /* the new arrowhead part of T needs to be reduced again */
+    treig.reduced = 0;
     /* move starting vector vector V(:,k+1);  V(:,trlen+1) = V(:,k+1) */
     DCOPY(&n, V+k*n, &one, V+trlen*n, &one);
   }      /* outer loop (it) */
@@ -448,7 +476,7 @@ res: related residual norms */
   free(Rval);
   free(resi);
   free(EvecT);
-  free(Rvec);
+  free_treig(&treig);
   free(s);
   free(work);
   //free(w3);
@@ -458,6 +486,9 @@ res: related residual norms */
   if (do_print) {
     fprintf(fstats, "------This slice consumed: \n");
     fprintf(fstats, "# of solves    :    %d\n", nsv);
+    if (rat->use_default_solver >= RATF_SOLVER_COCG) {
+      fprintf(fstats, "# of COCG its  :    %d\n", ratf_iter_count(rat));
+    }
     fprintf(fstats, "# of Matvec    :    %d\n", nmv);
     fprintf(fstats, "total time     :    %.2f\n", tall);
     fprintf(fstats, "filtering time :    %.2f\n", tmv);
@@ -3,6 +3,9 @@
 #include "blaslapack.h"
 #include "struct.h"
 #include "internal_proto.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /**-------------------------------------------------*
  * @brief convert csr to csc
@@ -260,6 +263,244 @@ int tri_sol_upper(char trans, csrMat *R, double *b, double *x) {
   return 0;
 }
 
+/* sort the rows 0..n-1 by level: lev[levptr[l]:levptr[l+1]-1] are the
+ * rows of level l */
+static void tri_sched_bucket(int n, int nlev, int *level, int **levptr,
+                             int **lev) {
+  int i, l, *ptr, *idx;
+  Calloc(ptr, nlev+1, int);
+  Malloc(idx, n, int);
+  for (i=0; i<n; i++) {
+    ptr[level[i]+1]++;
+  }
+  for (l=0; l<nlev; l++) {
+    ptr[l+1] += ptr[l];
+  }
+  for (i=0; i<n; i++) {
+    idx[ptr[level[i]]++] = i;
+  }
+  for (l=nlev; l>0; l--) {
+    ptr[l] = ptr[l-1];
+  }
+  ptr[0] = 0;
+  *levptr = ptr;
+  *lev = idx;
+}
+
+/**
+ * @brief Analyze the level schedules of the triangular solves with the
+ * upper triangular R and with R' [see tri_sol_upper_sched]. Done once,
+ * the schedules are used by all the solves
+ * @warning R must be sorted with a full diagonal [check_full_diag]
+ */
+void tri_sched_setup(csrMat *R, triSched *T) {
+  int i, j, n = R->nrows, nnz = R->ia[n], nlev = 0, *level;
+  /*-------------------- R' in CSR: rows sorted, so the diagonal is last */
+  csr_resize(n, n, nnz, &T->Rt);
+  csrcsc(0, n, n, 1, R->a, R->ja, R->ia, T->Rt.a, T->Rt.ja, T->Rt.ia);
+  Malloc(level, n, int);
+  /*-------------------- R' x = b: x(i) needs x(k) for R(k,i) != 0, k < i */
+  for (i=0; i<n; i++) {
+    level[i] = 0;
+  }
+  for (i=0; i<n; i++) {
+    for (j=R->ia[i]+1; j<R->ia[i+1]; j++) {
+      level[R->ja[j]] = max(level[R->ja[j]], level[i]+1);
+    }
+    nlev = max(nlev, level[i]+1);
+  }
+  tri_sched_bucket(n, nlev, level, &T->levptrL, &T->levL);
+  /*-------------------- R x = b: x(i) needs x(j) for R(i,j) != 0, j > i */
+  for (i=n-1; i>=0; i--) {
+    level[i] = 0;
+    for (j=R->ia[i]+1; j<R->ia[i+1]; j++) {
+      level[i] = max(level[i], level[R->ja[j]]+1);
+    }
+  }
+  tri_sched_bucket(n, nlev, level, &T->levptrU, &T->levU);
+  T->nlev = nlev;
+  /*-------------------- narrow levels are not worth a barrier each */
+  T->par = n >= TRI_SCHED_MINW * nlev;
+  free(level);
+}
+
+/**
+ * @brief Level-scheduled triangular solves with the permutation p fused
+ * (p = NULL: no permutation)
+ *   trans = 'N': x = P' * (R \ b), i.e., x(p) = R \ b
+ *   trans = 'T': x = R' \ (P * b), i.e., x = R' \ b(p)
+ * The rows of each level are solved in parallel
+ * @warning b and x must not overlap
+ */
+void tri_sol_upper_sched(char trans, csrMat *R, triSched *T, int *p,
+                         double *b, double *x) {
+  int l, k, i, j, nlev = T->nlev;
+  if (trans == 'T' || trans == 't') {
+    csrMat *L = &T->Rt;
+    int *levptr = T->levptrL, *lev = T->levL;
+#ifdef _OPENMP
+#pragma omp parallel if (T->par) private(l, k, i, j)
+#endif
+    for (l=0; l<nlev; l++) {
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (k=levptr[l]; k<levptr[l+1]; k++) {
+        int i2;
+        double xi;
+        i = lev[k];
+        i2 = L->ia[i+1] - 1;
+        xi = p ? b[p[i]] : b[i];
+        for (j=L->ia[i]; j<i2; j++) {
+          xi -= L->a[j] * x[L->ja[j]];
+        }
+        x[i] = xi / L->a[i2];
+      }
+    }
+  } else {
+    int *levptr = T->levptrU, *lev = T->levU;
+#ifdef _OPENMP
+#pragma omp parallel if (T->par) private(l, k, i, j)
+#endif
+    for (l=0; l<nlev; l++) {
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (k=levptr[l]; k<levptr[l+1]; k++) {
+        int i1;
+        double xi;
+        i = lev[k];
+        i1 = R->ia[i];
+        xi = b[i];
+        if (p) {
+          for (j=i1+1; j<R->ia[i+1]; j++) {
+            xi -= R->a[j] * x[p[R->ja[j]]];
+          }
+          x[p[i]] = xi / R->a[i1];
+        } else {
+          for (j=i1+1; j<R->ia[i+1]; j++) {
+            xi -= R->a[j] * x[R->ja[j]];
+          }
+          x[i] = xi / R->a[i1];
+        }
+      }
+    }
+  }
+}
+
+/* one row of the forward sweep of tri_genmv_sched: returns
+ * (A(r,:) * w - R'(i,1:i-1) * z(1:i-1)) / R'(i,i) */
+static inline double tri_genmv_row(int i, int r, int *ai, int *aj,
+                                   double *aa, int *li, int *lj, double *la,
+                                   double *w, double *z) {
+  int j, i2 = li[i+1] - 1;
+  double xi = 0.0;
+  for (j=ai[r]; j<ai[r+1]; j++) {
+    xi += aa[j] * w[aj[j]];
+  }
+  for (j=li[i]; j<i2; j++) {
+    xi -= la[j] * z[lj[j]];
+  }
+  return xi / la[i2];
+}
+
+/* y = R' \ (P A P') (R \ x) [cheb == 0], or one step of the Chebyshev
+ * recurrence with it [cheb == 1]:
+ *   z = R' \ (P A P') (R \ x),  y = alpha*(z - cc*x) - zm1,  acc += beta*y
+ * where z overwrites zm1 row by row */
+static void tri_genmv_core(csrMat *R, triSched *T, int *p, csrMat *A,
+                           int cheb, double alpha, double cc, double beta,
+                           double *x, double *zm1, double *y, double *acc,
+                           double *w) {
+  int l, k, i, n = R->nrows, nlev = T->nlev;
+  int *ai = A->ia, *aj = A->ja, *li = T->Rt.ia, *lj = T->Rt.ja;
+  double *aa = A->a, *la = T->Rt.a;
+  int *levptr = T->levptrL, *lev = T->levL;
+  /* where the rows of the solution z are kept */
+  double *z = cheb ? zm1 : y;
+  int par = T->par;
+#ifdef _OPENMP
+  par = par && omp_get_max_threads() > 1;
+#else
+  par = 0;
+#endif
+  tri_sol_upper_sched('N', R, T, p, x, w);
+  /*-------------------- sequential: natural row order, best locality */
+  if (!par) {
+    for (i=0; i<n; i++) {
+      double zi = tri_genmv_row(i, p ? p[i] : i, ai, aj, aa, li, lj, la, w, z);
+      if (cheb) {
+        double yi = alpha * (zi - cc * x[i]) - zm1[i];
+        zm1[i] = zi;
+        y[i] = yi;
+        acc[i] += beta * yi;
+      } else {
+        y[i] = zi;
+      }
+    }
+    return;
+  }
+#ifdef _OPENMP
+#pragma omp parallel private(l, k, i)
+#endif
+  for (l=0; l<nlev; l++) {
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (k=levptr[l]; k<levptr[l+1]; k++) {
+      double zi;
+      i = lev[k];
+      zi = tri_genmv_row(i, p ? p[i] : i, ai, aj, aa, li, lj, la, w, z);
+      if (cheb) {
+        double yi = alpha * (zi - cc * x[i]) - zm1[i];
+        zm1[i] = zi;
+        y[i] = yi;
+        acc[i] += beta * yi;
+      } else {
+        y[i] = zi;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Fused generalized matvec y = R' \ (P A P') (R \ x), i.e.,
+ * y = L \ A / L' x for B = L L' and the permuted factor R = L' [P B P'].
+ * Two passes instead of three:
+ *   w = P' * (R \ x)                   [backward sweep]
+ *   y(i) = (A(p(i),:) * w - R'(i,1:i-1) * y(1:i-1)) / R'(i,i)
+ * in the second pass, the rows of A are applied within the forward sweep
+ * [in its level order], so the intermediate A*w is never stored and the
+ * rows of A and R' are streamed together
+ * @param w  work array of size n
+ * @warning x, y and w must not overlap
+ */
+void tri_genmv_sched(csrMat *R, triSched *T, int *p, csrMat *A,
+                     double *x, double *y, double *w) {
+  tri_genmv_core(R, T, p, A, 0, 0.0, 0.0, 0.0, x, NULL, y, NULL, w);
+}
+
+/**
+ * @brief One step of the Chebyshev recurrence of the filter with the
+ * fused generalized matvec of tri_genmv_sched, Op = R' \ (P A P') / R,
+ *   vkp1 = alpha * (Op * vk - cc * vk) - vkm1,   y = y + beta * vkp1
+ * in the same forward sweep. vkm1 is overwritten [by Op * vk]
+ * @param w  work array of size n
+ */
+void tri_genmv_cheb_sched(csrMat *R, triSched *T, int *p, csrMat *A,
+                          double alpha, double cc, double beta, double *vk,
+                          double *vkm1, double *vkp1, double *y, double *w) {
+  tri_genmv_core(R, T, p, A, 1, alpha, cc, beta, vk, vkm1, vkp1, y, w);
+}
+
+void free_tri_sched(triSched *T) {
+  free_csr(&T->Rt);
+  free(T->levptrU);
+  free(T->levU);
+  free(T->levptrL);
+  free(T->levL);
+}
+
 /* C = alp * A + bet * B */
 int matadd(double alp, double bet, csrMat *A, csrMat *B, csrMat *C) {
   int *iw, nnzA, nnzB, nnzC, i, j;
@@ -17,6 +17,8 @@
  * @param *A    input matrix
  * @param Mdeg     degree of polynomial to be used. 
  * @param damping  type of damping to be used [0=none,1=jackson,2=sigma]
+ *                 [the Dolph-Chebyshev damping 3 of the filters is not
+ *                 available here]
  * @param nvec     number of random vectors to use for sampling
  * @param intv   an array of length 4  \n
  *                 [intv[0] intv[1]] is the interval of desired eigenvalues 
@@ -36,6 +38,11 @@ int kpmdos(csrMat *A, int Mdeg, int damping, int nvec, double *intv,
   } else {
     n = A->nrows;
   }
+  if (damping < 0 || damping > 2) {
+    fprintf(stdout, " error [%s (%d)]: damping %d is not supported\n",
+            __FILE__, __LINE__, damping);
+    return -1;
+  }
   double *vkp1, *w, *vkm1, *vk, *jac;
   Malloc(vkp1, n, double);
   Malloc(w, n, double);
@@ -63,7 +70,7 @@ int kpmdos(csrMat *A, int Mdeg, int damping, int nvec, double *intv,
   t = min(1.0-DBL_EPSILON, (bb-ctr)/wid);
   beta2 = acos(t);
   /*-------------------- compute damping coefs. */
-  dampcf(Mdeg, damping, jac);
+  dampcf(Mdeg, damping, 0.0, jac);
   //-------------------- readjust jac[0] it was divided by 2
   jac[0] = 1.0;
   memset(mu,0,(Mdeg+1)*sizeof(double));
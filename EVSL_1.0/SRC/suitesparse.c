@@ -2,11 +2,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include "def.h"
+#include "blaslapack.h"
 #include "struct.h"
 #include "internal_proto.h"
 #include "cholmod.h"
 #include "umfpack.h"
 
+/* data of the default solver for one pole: the numeric factorization
+ * and the UMFPACK control parameters, which are set once */
+typedef struct _umfpackData {
+  void *Numeric;
+  double Control[UMFPACK_CONTROL];
+  int real;  // if Numeric is the factorization of the real 2n x 2n form
+  double *w; // work array of size 4*n [real form only]
+} umfpackData;
+
 void umfpack_solvefunc(int n, double *br, double *bz, double *xr, double *xz,
                        void *data) {
   /*-------------------------------------------------------------------------
@@ -19,23 +29,236 @@ void umfpack_solvefunc(int n, double *br, double *bz, double *xr, double *xz,
    * OUTPUT:
    *   xr, xz: vectors of length n, complex solution (real and imaginary)
    *-------------------------------------------------------------------------*/
-  void* Numeric = data;
-  double Control[UMFPACK_CONTROL]; 
-  umfpack_zl_defaults(Control);
-  Control[UMFPACK_IRSTEP] = 0; // no iterative refinement for umfpack 
+  umfpackData *D = (umfpackData *) data;
+  if (D->real) {
+    /* the real form works on interleaved (real, imag) vectors */
+    int i;
+    double *b = D->w, *x = D->w + 2*n;
+    for (i=0; i<n; i++) {
+      b[2*i] = br[i];
+      b[2*i+1] = bz[i];
+    }
+    umfpack_dl_solve(UMFPACK_A, NULL, NULL, NULL, x, b, D->Numeric,
+                     D->Control, NULL);
+    for (i=0; i<n; i++) {
+      xr[i] = x[2*i];
+      xz[i] = x[2*i+1];
+    }
+    return;
+  }
   umfpack_zl_solve(UMFPACK_A, NULL, NULL, NULL, NULL, xr, xz, br, bz, 
-                   Numeric, Control, NULL); 
+                   D->Numeric, D->Control, NULL); 
+}
+
+/* interleaved complex version [linSolFuncZ]: UMFPACK takes packed complex
+ * vectors directly (Xz = Bz = NULL), and so does the real form */
+void umfpack_solvefunc_z(int n, complex double *b, complex double *x,
+                         void *data) {
+  umfpackData *D = (umfpackData *) data;
+  if (D->real) {
+    umfpack_dl_solve(UMFPACK_A, NULL, NULL, NULL, (double *) x, (double *) b,
+                     D->Numeric, D->Control, NULL);
+  } else {
+    umfpack_zl_solve(UMFPACK_A, NULL, NULL, NULL, NULL, (double *) x, NULL,
+                     (double *) b, NULL, D->Numeric, D->Control, NULL);
+  }
+}
+
+/* multiple right-hand side version [linSolFuncBlock]. UMFPACK solves
+ * one right-hand side at a time, so the columns are solved in turn, with
+ * the work space of umfpack_zl_wsolve allocated once for all of them */
+void umfpack_solvefunc_block(int n, int nrhs, double *br, double *bz,
+                             double *xr, double *xz, void *data) {
+  int r;
+  umfpackData *D = (umfpackData *) data;
+  SuiteSparse_long *Wi;
+  double *W;
+  if (D->real) {
+    for (r=0; r<nrhs; r++) {
+      umfpack_solvefunc(n, br+r*n, bz+r*n, xr+r*n, xz+r*n, data);
+    }
+    return;
+  }
+  Malloc(Wi, n, SuiteSparse_long);
+  Malloc(W, 10*n, double);
+  for (r=0; r<nrhs; r++) {
+    umfpack_zl_wsolve(UMFPACK_A, NULL, NULL, NULL, NULL, xr+r*n, xz+r*n,
+                      br+r*n, bz+r*n, D->Numeric, D->Control, NULL, Wi, W);
+  }
+  free(Wi);
+  free(W);
+}
+
+/* entries of the real 2n x 2n equivalent form of A - z I, with z = zr + i zc,
+ *   K = [A - zr I,   zc I  ]
+ *       [ -zc I,   A - zr I]
+ * in the interleaved ordering (real part of unknown i -> 2i, imaginary
+ * part -> 2i+1), so that K has the pattern of A with 2 x 2 blocks and
+ * K applies to interleaved complex vectors. Ap, Ai: CSC of A [symmetric]
+ * with a diagonal entry in each column. Ki is set if not NULL */
+static void umfpack_realform(int n, SuiteSparse_long *Ap, SuiteSparse_long *Ai,
+                             double *Ax, complex double z,
+                             SuiteSparse_long *Kp, SuiteSparse_long *Ki,
+                             double *Kx) {
+  int i, j, p, nz = 0;
+  double zr = creal(z), zc = cimag(z);
+  if (Kp) {
+    Kp[0] = 0;
+  }
+  for (j=0; j<n; j++) {
+    /*-------------------- column 2j: [A(:,j) - zr e_j; -zc e_j] */
+    for (p=Ap[j]; p<Ap[j+1]; p++) {
+      i = Ai[p];
+      if (Ki) {
+        Ki[nz] = 2*i;
+      }
+      Kx[nz++] = i == j ? Ax[p] - zr : Ax[p];
+      if (i == j) {
+        if (Ki) {
+          Ki[nz] = 2*j+1;
+        }
+        Kx[nz++] = -zc;
+      }
+    }
+    if (Kp) {
+      Kp[2*j+1] = nz;
+    }
+    /*-------------------- column 2j+1: [zc e_j; A(:,j) - zr e_j] */
+    for (p=Ap[j]; p<Ap[j+1]; p++) {
+      i = Ai[p];
+      if (i == j) {
+        if (Ki) {
+          Ki[nz] = 2*j;
+        }
+        Kx[nz++] = zc;
+      }
+      if (Ki) {
+        Ki[nz] = 2*i+1;
+      }
+      Kx[nz++] = i == j ? Ax[p] - zr : Ax[p];
+    }
+    if (Kp) {
+      Kp[2*j+2] = nz;
+    }
+  }
+}
+
+/* free the UMFPACK data of the poles [after a failure of the set up] */
+static void free_ratf_umfpack(ratparams *rat) {
+  int i;
+  for (i=0; i<rat->num; i++) {
+    umfpackData *D = (umfpackData *) rat->solshiftdata[i];
+    if (!D) {
+      continue;
+    }
+    if (D->Numeric) {
+      if (D->real) {
+        umfpack_dl_free_numeric(&D->Numeric);
+      } else {
+        umfpack_zl_free_numeric(&D->Numeric);
+      }
+    }
+    free(D->w);
+    free(D);
+    rat->solshiftdata[i] = NULL;
+  }
+  /* nothing left for free_rat */
+  rat->use_default_solver = RATF_SOLVER_USER;
+}
+
+/* set the default solver with the real 2n x 2n form of the poles
+ * [rat->realform]: real LU factorizations (umfpack_dl) that apply to
+ * interleaved complex vectors. The values of K are built for one pole
+ * at a time, in a buffer of each thread */
+static int set_ratf_solfunc_realform(int n, SuiteSparse_long *Ap,
+                                     SuiteSparse_long *Ai, double *Ax,
+                                     ratparams *rat) {
+  int i, num = rat->num, nnzK, status, err = 0, *stat = NULL;
+  SuiteSparse_long *Kp, *Ki;
+  double *Kx;
+  void *Symbolic = NULL;
+  nnzK = 2*Ap[n] + 2*n;
+  Malloc(Kp, 2*n+1, SuiteSparse_long);
+  Malloc(Ki, nnzK, SuiteSparse_long);
+  Malloc(Kx, nnzK, double);
+  /* the pattern is the same for all the poles */
+  umfpack_realform(n, Ap, Ai, Ax, rat->zk[0], Kp, Ki, Kx);
+  status = umfpack_dl_symbolic(2*n, 2*n, Kp, Ki, Kx, &Symbolic, NULL, NULL);
+  free(Kx);
+  if (status < 0) {
+    printf("umfpack_dl_symbolic failed, %d\n", status);
+    err = 1;
+    goto done;
+  }
+  Malloc(stat, num, int);
+#ifdef _OPENMP
+#pragma omp parallel private(i)
+#endif
+  {
+    double *Kxi;
+    Malloc(Kxi, nnzK, double);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (i=0; i<num; i++) {
+      umfpackData *D;
+      Malloc(D, 1, umfpackData);
+      D->Numeric = NULL;
+      D->real = 1;
+      Malloc(D->w, 4*n, double);
+      umfpack_realform(n, Ap, Ai, Ax, rat->zk[i], NULL, NULL, Kxi);
+      stat[i] = umfpack_dl_numeric(Kp, Ki, Kxi, Symbolic, &D->Numeric,
+                                   NULL, NULL);
+      umfpack_dl_defaults(D->Control);
+      D->Control[UMFPACK_IRSTEP] = 0; // no iterative refinement for umfpack
+      rat->solshift[i] = umfpack_solvefunc;
+      rat->solshiftblk[i] = umfpack_solvefunc_block;
+      rat->solshiftz[i] = umfpack_solvefunc_z;
+      rat->solshiftdata[i] = D;
+    }
+    free(Kxi);
+  }
+  for (i=0; i<num; i++) {
+    if (stat[i] < 0) {
+      printf("umfpack_dl_numeric failed and exit, %d\n", stat[i]);
+      err = 1;
+    }
+  }
+done:
+  if (Symbolic) {
+    umfpack_dl_free_symbolic(&Symbolic);
+  }
+  free(Kp);
+  free(Ki);
+  free(stat);
+  return err;
+}
+
+/* the values of A - z I in Axi, Azi [Ax with the diagonal in diag] */
+static void umfpack_shift(int n, int nnz, double *Ax, int *diag,
+                          complex double z, double *Axi, double *Azi) {
+  int j;
+  memcpy(Axi, Ax, nnz*sizeof(double));
+  memset(Azi, 0, nnz*sizeof(double));
+  for (j=0; j<n; j++) {
+    Axi[diag[j]] -= creal(z);
+    Azi[diag[j]] -= cimag(z);
+  }
 }
 
 /* set default solver */
 int set_ratf_solfunc_default(csrMat *A, ratparams *rat) {
-  int i, j, n, nnz, nnz2=0, status, *diag;
+  int i, j, n, nnz, nnz2=0, num, status, err = 0, *stat = NULL, *diag;
   SuiteSparse_long *Ap, *Ai;
-  double *Ax, *Az;
-  void *Symbolic=NULL, *Numeric=NULL;
+  double *Ax, *Axs, *Azs, Info[UMFPACK_INFO];
+  void *Symbolic=NULL;
 
   n = A->nrows;
   nnz = A->ia[n];
+  num = rat->num;
+  for (i=0; i<num; i++) {
+    rat->solshiftdata[i] = NULL;
+  }
 
   /* save the position of diag entry of each row */
   Malloc(diag, n, int);
@@ -44,9 +267,8 @@ int set_ratf_solfunc_default(csrMat *A, ratparams *rat) {
   /* allocate nnz+n spaces, in the worst case: A has no nonzero diag entry */
   Malloc(Ai, nnz+n, SuiteSparse_long);
   Malloc(Ax, nnz+n, double);
-  Malloc(Az, nnz+n, double);
 
-  /* copy A to Ap, Ai, Ax, Az
+  /* copy A to Ap, Ai, Ax
    * we consider general cases where A may not have full diagonal
    * this code will handle these cases */
   Ap[0] = 0;
@@ -58,7 +280,6 @@ int set_ratf_solfunc_default(csrMat *A, ratparams *rat) {
       /* copy value and col idx */
       Ai[nnz2] = col;
       Ax[nnz2] = val;
-      Az[nnz2] = 0.0;
       /* mark diagonal entry */
       if (col == i) {
         diag[i] = nnz2;
@@ -70,7 +291,6 @@ int set_ratf_solfunc_default(csrMat *A, ratparams *rat) {
     if (!rowi_has_diag) {
       Ai[nnz2] = i;
       Ax[nnz2] = 0.0;
-      Az[nnz2] = 0.0;
       diag[i] = nnz2;
       nnz2++;
     }
@@ -78,65 +298,113 @@ int set_ratf_solfunc_default(csrMat *A, ratparams *rat) {
     Ap[i+1] = nnz2;
   }
 
-  /* for each pole we shift the diagonal and factorize */
-  for (i=0; i<rat->num; i++) {
-    /* the complex shift for pole i */
-    double zkr = creal(rat->zk[i]);
-    double zkc = cimag(rat->zk[i]);
-    /* shift the diagonal */
-    for (j=0; j<n; j++) {
-      int dj = diag[j];
-      Ax[dj] -= zkr;
-      Az[dj] -= zkc;
-    }
-    
-    /* only do symbolic factorization once */
-    if (i==0) {
-      /* Symbolic Factorization */
-      status = umfpack_zl_symbolic (n, n, Ap, Ai, Ax, Az, &Symbolic, NULL, NULL);
-      if (status < 0) {
-        printf("umfpack_zl_symbolic failed, %d\n", status);
-        return 1;
-      }
-    }
-    /* Numerical Factorization */
-    status = umfpack_zl_numeric(Ap, Ai, Ax, Az, Symbolic, &Numeric, NULL, NULL);
-    if (status < 0) {
-      printf("umfpack_zl_numeric failed and exit, %d\n", status);
-      return 1;
-    }
+  /* real 2n x 2n form of the poles */
+  if (rat->realform) {
+    err = set_ratf_solfunc_realform(n, Ap, Ai, Ax, rat);
+    goto done;
+  }
 
-    /* set solver pointer and data */
-    rat->solshift[i] = umfpack_solvefunc;
-    rat->solshiftdata[i] = Numeric;
-    
-    /* shift the diagonal back */
-    for (j=0; j<n; j++) {
-      int dj = diag[j];
-      Ax[dj] += zkr;
-      Az[dj] += zkc;
+  /* only do symbolic factorization once: all the poles have the same
+   * nonzero pattern [with the values of the first pole] */
+  Malloc(Axs, nnz2, double);
+  Malloc(Azs, nnz2, double);
+  umfpack_shift(n, nnz2, Ax, diag, rat->zk[0], Axs, Azs);
+  status = umfpack_zl_symbolic (n, n, Ap, Ai, Axs, Azs, &Symbolic, NULL, Info);
+  free(Axs);
+  free(Azs);
+  if (status < 0) {
+    printf("umfpack_zl_symbolic failed, %d\n", status);
+    err = 1;
+    goto done;
+  }
+
+  /* memory budget: if the estimated LU factors of the poles do not fit,
+   * use the LDL^T solver, whose factors are smaller (one triangle) and
+   * which can keep part of them out of core */
+  rat->factbytes = (size_t) (Info[UMFPACK_NUMERIC_SIZE_ESTIMATE] *
+                             Info[UMFPACK_SIZE_OF_UNIT]);
+  rat->memplan = 0;
+  rat->nincore = num;
+  if (rat->membudget > 0 && rat->factbytes * num > rat->membudget) {
+    printf("rational filter memory plan: %d UMFPACK factors of %.1f MB "
+           "exceed the budget (%.1f MB), using LDL^T\n", num,
+           rat->factbytes / 1048576.0, rat->membudget / 1048576.0);
+    rat->use_default_solver = RATF_SOLVER_LDL;
+    err = set_ratf_solfunc_ldl(A, rat);
+    goto done;
+  }
+
+  /* Numerical Factorization of the poles in parallel, sharing Symbolic.
+   * The values of the shifted matrix A - z_i I are set in a buffer of
+   * each thread, so the extra memory does not grow with the poles */
+  Malloc(stat, num, int);
+#ifdef _OPENMP
+#pragma omp parallel private(i)
+#endif
+  {
+    double *Axi, *Azi;
+    Malloc(Axi, nnz2, double);
+    Malloc(Azi, nnz2, double);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (i=0; i<num; i++) {
+      umfpackData *D;
+      Malloc(D, 1, umfpackData);
+      D->Numeric = NULL;
+      D->real = 0;
+      D->w = NULL;
+      umfpack_shift(n, nnz2, Ax, diag, rat->zk[i], Axi, Azi);
+      stat[i] = umfpack_zl_numeric(Ap, Ai, Axi, Azi, Symbolic, &D->Numeric,
+                                   NULL, NULL);
+      umfpack_zl_defaults(D->Control);
+      D->Control[UMFPACK_IRSTEP] = 0; // no iterative refinement for umfpack
+      /* set solver pointer and data */
+      rat->solshift[i] = umfpack_solvefunc;
+      rat->solshiftblk[i] = umfpack_solvefunc_block;
+      rat->solshiftz[i] = umfpack_solvefunc_z;
+      rat->solshiftdata[i] = D;
+    }
+    free(Axi);
+    free(Azi);
+  }
+  for (i=0; i<num; i++) {
+    if (stat[i] < 0) {
+      printf("umfpack_zl_numeric failed and exit, %d\n", stat[i]);
+      err = 1;
     }
-  } // for (i=0; i<rat->num,...)
+  }
 
+done:
+  /* failure: free the factors of the poles that were done */
+  if (err && rat->use_default_solver == RATF_SOLVER_UMFPACK) {
+    free_ratf_umfpack(rat);
+  }
   /* free the symbolic fact */
   if (Symbolic) {
     umfpack_zl_free_symbolic(&Symbolic);
   }
-
   free(diag);
   free(Ap);
   free(Ai);
   free(Ax);
-  free(Az);
+  free(stat);
 
-  return 0;
+  return err;
 }
 
 void free_rat_default_sol(ratparams *rat) {
   int i;
-  if (rat->use_default_solver) {
+  if (rat->use_default_solver == RATF_SOLVER_UMFPACK) {
     for (i=0; i<rat->num; i++) {
-      umfpack_zl_free_numeric(&rat->solshiftdata[i]);
+      umfpackData *D = (umfpackData *) rat->solshiftdata[i];
+      if (D->real) {
+        umfpack_dl_free_numeric(&D->Numeric);
+      } else {
+        umfpack_zl_free_numeric(&D->Numeric);
+      }
+      free(D->w);
+      free(D);
     }
   }
 }
@@ -166,12 +434,114 @@ cholmod_sparse* csrMat_to_cholmod_sparse(csrMat *A, int stype) {
   return B;
 }
 
+/* supernodal Cholesky factor L of B, as stored by CHOLMOD: supernode k
+ * holds the columns super[k] to super[k+1]-1 of L. Its row indices are
+ * s[pi[k]:pi[k+1]-1] (the columns of the supernode first) and its values
+ * are the dense column-major block x[px[k]:], of leading dimension
+ * pi[k+1]-pi[k] */
+typedef struct _superLB {
+  int n, nsuper;
+  int *super, *pi, *px, *s;
+  double *x;
+  int maxrow;         // max number of off-diagonal rows of a supernode
+  double *work;       // work space of size n + maxrow
+} superLB;
+
 typedef struct _default_LBdata {
-  csrMat R;
+  int is_super;       // if the factor is kept in supernodal form [S]
+  superLB S;
+  csrMat R;           // else, R = L' in CSR
   int *perm;
-  double *work;
+  triSched sched;     // level schedules of the solves with R and R'
 } default_LBdata;
 
+/* copy the supernodal factor of CHOLMOD */
+static void superLB_copy(cholmod_factor *LB, superLB *S) {
+  int k, nsuper = LB->nsuper, *super = (int *) LB->super;
+  int *pi = (int *) LB->pi, *px = (int *) LB->px;
+  S->n = LB->n;
+  S->nsuper = nsuper;
+  Malloc(S->super, nsuper+1, int);
+  Malloc(S->pi, nsuper+1, int);
+  Malloc(S->px, nsuper+1, int);
+  Malloc(S->s, pi[nsuper], int);
+  Malloc(S->x, px[nsuper], double);
+  memcpy(S->super, super, (nsuper+1)*sizeof(int));
+  memcpy(S->pi, pi, (nsuper+1)*sizeof(int));
+  memcpy(S->px, px, (nsuper+1)*sizeof(int));
+  memcpy(S->s, LB->s, pi[nsuper]*sizeof(int));
+  memcpy(S->x, LB->x, px[nsuper]*sizeof(double));
+  S->maxrow = 0;
+  for (k=0; k<nsuper; k++) {
+    int nsrow = pi[k+1] - pi[k], nscol = super[k+1] - super[k];
+    S->maxrow = max(S->maxrow, nsrow - nscol);
+  }
+  Malloc(S->work, S->n + S->maxrow, double);
+}
+
+static void superLB_free(superLB *S) {
+  free(S->super);
+  free(S->pi);
+  free(S->px);
+  free(S->s);
+  free(S->x);
+  free(S->work);
+}
+
+/* X = L \ X in place, for the nrhs columns of X [leading dimension ldx].
+ * w is a work array of size maxrow*nrhs */
+static void superLB_lsolve(superLB *S, int nrhs, double *X, int ldx,
+                           double *w) {
+  int k, i, r;
+  double one = 1.0, zero = 0.0;
+  char cL = 'L', cN = 'N';
+  for (k=0; k<S->nsuper; k++) {
+    int k1 = S->super[k], nscol = S->super[k+1] - k1;
+    int nsrow = S->pi[k+1] - S->pi[k], nrow2 = nsrow - nscol;
+    int *s2 = S->s + S->pi[k] + nscol;
+    double *Lk = S->x + S->px[k];
+    /*-------------------- X1 = L11 \ X1 */
+    DTRSM(&cL, &cL, &cN, &cN, &nscol, &nrhs, &one, Lk, &nsrow, X+k1, &ldx);
+    if (nrow2 == 0) {
+      continue;
+    }
+    /*-------------------- W = L21 * X1, and X2 -= W (scatter) */
+    DGEMM(&cN, &cN, &nrow2, &nrhs, &nscol, &one, Lk+nscol, &nsrow, X+k1,
+          &ldx, &zero, w, &nrow2);
+    for (r=0; r<nrhs; r++) {
+      for (i=0; i<nrow2; i++) {
+        X[r*ldx+s2[i]] -= w[r*nrow2+i];
+      }
+    }
+  }
+}
+
+/* X = L' \ X in place [see superLB_lsolve] */
+static void superLB_ltsolve(superLB *S, int nrhs, double *X, int ldx,
+                            double *w) {
+  int k, i, r;
+  double one = 1.0, mone = -1.0;
+  char cL = 'L', cN = 'N', cT = 'T';
+  for (k=S->nsuper-1; k>=0; k--) {
+    int k1 = S->super[k], nscol = S->super[k+1] - k1;
+    int nsrow = S->pi[k+1] - S->pi[k], nrow2 = nsrow - nscol;
+    int *s2 = S->s + S->pi[k] + nscol;
+    double *Lk = S->x + S->px[k];
+    /*-------------------- W = X2 (gather), and X1 -= L21' * W */
+    if (nrow2 > 0) {
+      for (r=0; r<nrhs; r++) {
+        for (i=0; i<nrow2; i++) {
+          w[r*nrow2+i] = X[r*ldx+s2[i]];
+        }
+      }
+      DGEMM(&cT, &cN, &nscol, &nrhs, &nrow2, &mone, Lk+nscol, &nsrow, w,
+            &nrow2, &one, X+k1, &ldx);
+    }
+    /*-------------------- X1 = L11' \ X1 */
+    DTRSM(&cL, &cL, &cT, &cN, &nscol, &nrhs, &one, Lk, &nsrow, X+k1, &ldx);
+  }
+}
+
 /*
 void vector_to_cholmod_dense(int nrow, int ncol, double *v, int ldv,
                              cholmod_dense *x) {
@@ -191,24 +561,34 @@ void vector_to_cholmod_dense(int nrow, int ncol, double *v, int ldv,
  *         = 2 : x = L \ P * b
  */ 
 void default_Lsol_combine(int soltype, double *b, double *x, void *data) {
-  int n;
   default_LBdata *LBdata = (default_LBdata *) data;
   csrMat *R = &LBdata->R;
   int *p = LBdata->perm;
-  double *w = LBdata->work;
-  n = R->nrows;
 
-  /* solve with L */
+  /* supernodal factor: dense block solves, in place */
+  if (LBdata->is_super) {
+    superLB *S = &LBdata->S;
+    int n = S->n;
+    if (1 == soltype) {
+      /* x = P' * (L' \ b) */
+      memcpy(S->work, b, n*sizeof(double));
+      superLB_ltsolve(S, 1, S->work, n, S->work+n);
+      vec_iperm(n, p, S->work, x);
+    } else if (2 == soltype) {
+      /* x = L \ (P * b) */
+      vec_perm(n, p, b, x);
+      superLB_lsolve(S, 1, x, n, S->work+n);
+    }
+    return;
+  }
+
+  /* solve with L, the permutation is applied within the solves */
   if (1 == soltype) {
-    /* w = L' \ b */
-    tri_sol_upper('N', R, b, w);
-    /* x = P' * w */
-    vec_iperm(n, p, w, x);
+    /* x = P' * (L' \ b) */
+    tri_sol_upper_sched('N', R, &LBdata->sched, p, b, x);
   } else if (2 == soltype) {
-    /* w = P * b */
-    vec_perm(n, p, b, w);
-    /* x = L \ w */
-    tri_sol_upper('T', R, w, x);
+    /* x = L \ (P * b) */
+    tri_sol_upper_sched('T', R, &LBdata->sched, p, b, x);
   }
 }
 
@@ -220,6 +600,22 @@ void default_LTSol(double *x, double *y, void *data) {
   default_Lsol_combine(1, x, y, data);
 }
 
+/* fused y = L \ A / L' x with the CSR factor [see tri_genmv_sched] */
+void default_LGenMV(csrMat *A, double *x, double *y, double *w,
+                    void *data) {
+  default_LBdata *LBdata = (default_LBdata *) data;
+  tri_genmv_sched(&LBdata->R, &LBdata->sched, LBdata->perm, A, x, y, w);
+}
+
+/* one step of the filter fused with L \ A / L' [see tri_genmv_cheb_sched] */
+void default_LChebStep(csrMat *A, double alpha, double cc, double beta,
+                       double *vk, double *vkm1, double *vkp1, double *y,
+                       double *w, void *data) {
+  default_LBdata *LBdata = (default_LBdata *) data;
+  tri_genmv_cheb_sched(&LBdata->R, &LBdata->sched, LBdata->perm, A, alpha,
+                       cc, beta, vk, vkm1, vkp1, y, w);
+}
+
 int set_default_LBdata(csrMat *B) {
   int i, n = B->nrows, nnzL;
   cholmod_sparse *Bcholmod, *LBmat;
@@ -251,32 +647,41 @@ int set_default_LBdata(csrMat *B) {
   /* check the factor */
   CHKERR(LB->is_ll == 0);
   cholmod_check_factor(LB, cc);
-  /* convert factor to sparse matrix [col format as in CHOLMOD]*/
-  LBmat = cholmod_factor_to_sparse(LB, cc);
-  /* check some fields of LBmat */
-  if (!LBmat->packed) {
-    printf("error: cholmod_sparse matrix L is not packed\n");
-    CHKERR(1);
-  }
-  CHKERR(n != LBmat->ncol || n != LBmat->nrow);
-  /* convert it to csrMat, which is *upper* triangular */
-  nnzL = ((int *) (LBmat->p))[n];
-  csr_resize(n, n, nnzL, &LBdata->R);
-  LBdata->R.nrows = n;
-  LBdata->R.ncols = n;
-  memcpy(LBdata->R.ia, LBmat->p, (n+1)*sizeof(int));
-  memcpy(LBdata->R.ja, LBmat->i, nnzL*sizeof(int));
-  memcpy(LBdata->R.a, LBmat->x, nnzL*sizeof(double));
-  /* R should be sorted */
-  if (!LBmat->sorted) {
-    printf("cholmod_sparse L was not sorted, so we do the sorting\n");
-    /* make rows of R have increasing col ids */
-    sortrow(&LBdata->R);
-  }
-  /* check diag of */
-  if (check_full_diag('U', &LBdata->R)) {
-    printf("error: R has zero diag entry!\n");
-    return 1;
+  /* a supernodal factor is kept as it is, and solved by dense blocks */
+  LBdata->is_super = LB->is_super;
+  LBmat = NULL;
+  if (LB->is_super) {
+    superLB_copy(LB, &LBdata->S);
+  } else {
+    /* convert factor to sparse matrix [col format as in CHOLMOD]*/
+    LBmat = cholmod_factor_to_sparse(LB, cc);
+    /* check some fields of LBmat */
+    if (!LBmat->packed) {
+      printf("error: cholmod_sparse matrix L is not packed\n");
+      CHKERR(1);
+    }
+    CHKERR(n != LBmat->ncol || n != LBmat->nrow);
+    /* convert it to csrMat, which is *upper* triangular */
+    nnzL = ((int *) (LBmat->p))[n];
+    csr_resize(n, n, nnzL, &LBdata->R);
+    LBdata->R.nrows = n;
+    LBdata->R.ncols = n;
+    memcpy(LBdata->R.ia, LBmat->p, (n+1)*sizeof(int));
+    memcpy(LBdata->R.ja, LBmat->i, nnzL*sizeof(int));
+    memcpy(LBdata->R.a, LBmat->x, nnzL*sizeof(double));
+    /* R should be sorted */
+    if (!LBmat->sorted) {
+      printf("cholmod_sparse L was not sorted, so we do the sorting\n");
+      /* make rows of R have increasing col ids */
+      sortrow(&LBdata->R);
+    }
+    /* check diag of */
+    if (check_full_diag('U', &LBdata->R)) {
+      printf("error: R has zero diag entry!\n");
+      return 1;
+    }
+    /* level schedules of the triangular solves */
+    tri_sched_setup(&LBdata->R, &LBdata->sched);
   }
   /* copy the perm array */
   int *cholmod_perm = (int*) LB->Perm;
@@ -288,18 +693,20 @@ int set_default_LBdata(csrMat *B) {
   } else {
     LBdata->perm = NULL;
   }
-  /* allocate workspace */
-  Malloc(LBdata->work, n, double);
   /* save the struct to global variable */
   evsldata.LB_func_data = (void *) LBdata;
   evsldata.LB_solv = default_LSol;
   evsldata.LBT_solv = default_LTSol;
+  evsldata.LB_genmv = LBdata->is_super ? NULL : default_LGenMV;
+  evsldata.LB_chebstep = LBdata->is_super ? NULL : default_LChebStep;
   /* free the matrix wrapper */
   free(Bcholmod);
   /* free the factor */
   cholmod_free_factor(&LB, cc);
   /* free sparse matrix */
-  cholmod_free_sparse(&LBmat, cc);
+  if (LBmat) {
+    cholmod_free_sparse(&LBmat, cc);
+  }
   /* finish cholmod */
   cholmod_finish(cc);
   
@@ -308,8 +715,12 @@ int set_default_LBdata(csrMat *B) {
 
 void free_default_LBdata() {
   default_LBdata *LBdata = (default_LBdata *) evsldata.LB_func_data;
-  free_csr(&LBdata->R);
+  if (LBdata->is_super) {
+    superLB_free(&LBdata->S);
+  } else {
+    free_csr(&LBdata->R);
+    free_tri_sched(&LBdata->sched);
+  }
   free(LBdata->perm);
-  free(LBdata->work);
 }
 
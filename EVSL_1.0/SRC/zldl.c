@@ -0,0 +1,1108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "def.h"
+#include "struct.h"
+#include "internal_proto.h"
+#ifdef EVSL_WITH_SUITESPARSE
+#include "amd.h"
+#endif
+
+/**
+ * @file zldl.c
+ * @brief Built-in sparse LDL^T solver for the complex symmetric shifted
+ * systems (A - z_k I) x = b of the rational filter
+ *
+ * A - z_k I is complex symmetric (not Hermitian): it is factored as
+ * P (A - z_k I) P' = L D L^T, where L^T is the plain transpose (no
+ * conjugation). Since Im(z_k) > 0 and A is real symmetric, the imaginary
+ * part of the matrix is definite and the factorization exists without
+ * pivoting. Only one triangle is factored and stored, and the ordering,
+ * the elimination tree and the pattern of L are shared by all the poles,
+ * so each pole only keeps the complex values of L and D
+ *
+ * The factors can be kept in a cache keyed by (matrix, shift) [see
+ * SetFactCache], so that the slices and the runs that use the same poles
+ * on the same matrix do not factor again. The cache has a memory budget
+ * (least recently used factors are dropped first) and can save the
+ * factors to a directory to reuse them across runs
+ */
+
+/* symbolic part of the factorization, shared by all the poles */
+typedef struct _zldlSym {
+  int n;
+  int *perm, *iperm;  // fill-reducing ordering and its inverse
+  int *parent;        // elimination tree
+  int *Lp, *Li;       // pattern of L in CSC (strict lower part)
+  int haveLi;         // if Li has been set by a numeric factorization
+  int nref;           // number of numeric factors using it
+  int cached;         // if it is owned by the factorization cache
+  unsigned long long mkey; // hash of the matrix [cache key]
+  struct _zldlSym *next;
+} zldlSym;
+
+/* numeric factorization for one shift */
+typedef struct _zldlFact {
+  zldlSym *S;
+  complex double *Lx; // values of L
+  complex double *D;  // diagonal D
+  complex double zk;  // the shift [cache key, with S->mkey]
+  int refs;           // number of poles (of all the filters) using it
+  int cached;         // if it is owned by the factorization cache
+  size_t bytes;       // memory of Lx and D
+  unsigned long stamp;// time of last use [LRU]
+  FILE *fp;           // out of core: file that holds D and Lx [which are
+                      // NULL then]
+  struct _zldlFact *next;
+} zldlFact;
+
+/* buffer for the factors of the out-of-core poles of a filter, which are
+ * read into it when they are needed */
+typedef struct _zldlPage {
+  zldlFact view;      // the factors in the buffer
+  zldlFact *cur;      // the pole whose factors are in the buffer
+} zldlPage;
+
+/* the data passed to zldl_solvefunc for one pole */
+typedef struct _zldlData {
+  zldlFact *F;
+  zldlPage *page;     // for out-of-core factors [NULL if in core]
+  complex double *w;  // work array of size n*nw for the solves
+  int nw;             // number of right-hand sides w can hold
+} zldlData;
+
+/**
+ * @brief Breadth first search on the graph of A from node root.
+ * The visited nodes are marked with stamp and stored in q
+ * (level by level, neighbors sorted by increasing degree)
+ * @return number of nodes visited
+ */
+static int rcm_bfs(csrMat *A, int *deg, int root, int *mark, int stamp,
+                   int *q) {
+  int head = 0, tail = 1, j, p;
+  q[0] = root;
+  mark[root] = stamp;
+  while (head < tail) {
+    int v = q[head++];
+    int t0 = tail;
+    for (p=A->ia[v]; p<A->ia[v+1]; p++) {
+      int u = A->ja[p];
+      if (mark[u] != stamp) {
+        mark[u] = stamp;
+        /*-------------------- insertion sort by degree */
+        for (j=tail; j>t0 && deg[q[j-1]] > deg[u]; j--) {
+          q[j] = q[j-1];
+        }
+        q[j] = u;
+        tail++;
+      }
+    }
+  }
+  return tail;
+}
+
+/**
+ * @brief Reverse Cuthill-McKee ordering of the symmetric matrix A,
+ * used when AMD is not available. A root is taken from the far end of a
+ * first BFS in each connected component (pseudo-peripheral node)
+ * @param[out] perm  perm[k] is the original index of the k-th node
+ */
+static void rcm_order(csrMat *A, int *perm) {
+  int n = A->nrows, i, k, pos = 0, stamp = 0;
+  int *deg, *mark, *q;
+  Malloc(deg, n, int);
+  Malloc(mark, n, int);
+  Malloc(q, n, int);
+  for (i=0; i<n; i++) {
+    deg[i] = A->ia[i+1] - A->ia[i];
+    mark[i] = -1;
+  }
+  for (i=0; i<n; i++) {
+    int nv, root;
+    /*-------------------- node already numbered (stamp of a final BFS) */
+    if (mark[i] >= 0 && mark[i] % 2 == 1) {
+      continue;
+    }
+    /*-------------------- trial BFS to find a pseudo-peripheral root */
+    nv = rcm_bfs(A, deg, i, mark, stamp, q);
+    root = q[nv-1];
+    stamp++;
+    /*-------------------- final BFS, numbered in reverse order */
+    nv = rcm_bfs(A, deg, root, mark, stamp, q);
+    stamp++;
+    for (k=0; k<nv; k++) {
+      perm[n-1-pos-k] = q[k];
+    }
+    pos += nv;
+  }
+  free(deg);
+  free(mark);
+  free(q);
+}
+
+/**
+ * @brief Symbolic LDL^T factorization of P*A*P': ordering, elimination
+ * tree and column counts of L. Only the pattern of A is used
+ */
+static zldlSym *zldl_symbolic(csrMat *A) {
+  int n = A->nrows, i, k, p, *flag, *Lnz;
+  zldlSym *S;
+  Malloc(S, 1, zldlSym);
+  S->n = n;
+  Malloc(S->perm, n, int);
+  Malloc(S->iperm, n, int);
+  Malloc(S->parent, n, int);
+  Malloc(S->Lp, n+1, int);
+  /*-------------------- fill-reducing ordering */
+#ifdef EVSL_WITH_SUITESPARSE
+  if (amd_order(n, A->ia, A->ja, S->perm, NULL, NULL) < AMD_OK) {
+    rcm_order(A, S->perm);
+  }
+#else
+  rcm_order(A, S->perm);
+#endif
+  for (k=0; k<n; k++) {
+    S->iperm[S->perm[k]] = k;
+  }
+  /*-------------------- elimination tree and nnz of each column of L */
+  Malloc(flag, n, int);
+  Lnz = S->Lp + 1;
+  for (k=0; k<n; k++) {
+    int kk = S->perm[k];
+    S->parent[k] = -1;
+    flag[k] = k;
+    Lnz[k] = 0;
+    for (p=A->ia[kk]; p<A->ia[kk+1]; p++) {
+      i = S->iperm[A->ja[p]];
+      if (i < k) {
+        /*-------------------- follow the path from i to the root */
+        for (; flag[i] != k; i = S->parent[i]) {
+          if (S->parent[i] == -1) {
+            S->parent[i] = k;
+          }
+          Lnz[i]++;
+          flag[i] = k;
+        }
+      }
+    }
+  }
+  S->Lp[0] = 0;
+  for (k=0; k<n; k++) {
+    S->Lp[k+1] += S->Lp[k];
+  }
+  Malloc(S->Li, S->Lp[n], int);
+  S->haveLi = 0;
+  S->nref = 0;
+  S->cached = 0;
+  S->mkey = 0;
+  S->next = NULL;
+  free(flag);
+  return S;
+}
+
+/**
+ * @brief Numeric LDL^T factorization of P*(A - sigma I)*P'
+ * (up-looking, row by row of L). A itself is not modified
+ * @param setLi  if the row indices of L are to be written in S->Li.
+ *               They are the same for all the shifts, so only the first
+ *               factorization needs to store them
+ * @return 0 on success, k+1 if D(k) is zero
+ */
+static int zldl_numeric(csrMat *A, zldlSym *S, complex double sigma,
+                        int setLi, zldlFact *F) {
+  int n = S->n, i, k, p, top, len, err = 0;
+  int *flag, *Lnz, *pattern;
+  complex double *Y;
+  Malloc(flag, n, int);
+  Malloc(Lnz, n, int);
+  Malloc(pattern, n, int);
+  Malloc(Y, n, complex double);
+  for (k=0; k<n; k++) {
+    int kk = S->perm[k];
+    /*-------------------- scatter row k of P*A*P' (upper part) into Y and
+     *                     find the pattern of row k of L */
+    Y[k] = 0.0;
+    top = n;
+    flag[k] = k;
+    Lnz[k] = 0;
+    for (p=A->ia[kk]; p<A->ia[kk+1]; p++) {
+      i = S->iperm[A->ja[p]];
+      if (i <= k) {
+        Y[i] += A->a[p];
+        for (len=0; flag[i] != k; i = S->parent[i]) {
+          pattern[len++] = i;
+          flag[i] = k;
+        }
+        while (len > 0) {
+          pattern[--top] = pattern[--len];
+        }
+      }
+    }
+    /*-------------------- apply the shift */
+    F->D[k] = Y[k] - sigma;
+    Y[k] = 0.0;
+    /*-------------------- sparse triangular solve for row k of L */
+    for (; top<n; top++) {
+      complex double yi, lki;
+      int p2;
+      i = pattern[top];
+      yi = Y[i];
+      Y[i] = 0.0;
+      p2 = S->Lp[i] + Lnz[i];
+      for (p=S->Lp[i]; p<p2; p++) {
+        Y[S->Li[p]] -= F->Lx[p] * yi;
+      }
+      /*-------------------- no conjugation: L D L^T */
+      lki = yi / F->D[i];
+      F->D[k] -= lki * yi;
+      if (setLi) {
+        S->Li[p] = k;
+      }
+      F->Lx[p] = lki;
+      Lnz[i]++;
+    }
+    if (F->D[k] == 0.0) {
+      err = k + 1;
+      break;
+    }
+  }
+  free(flag);
+  free(Lnz);
+  free(pattern);
+  free(Y);
+  return err;
+}
+
+/* the factors of the pole of H, read from the file if they are out of
+ * core. NULL if they cannot be read [the buffer is then invalid] */
+static zldlFact *zldl_fact(zldlData *H) {
+  zldlFact *F = H->F;
+  zldlPage *pg = H->page;
+  int n, nnzL;
+  if (!F->fp) {
+    return F;
+  }
+  if (pg->cur != F) {
+    n = F->S->n;
+    nnzL = F->S->Lp[n];
+    rewind(F->fp);
+    if (fread(pg->view.D, sizeof(complex double), n, F->fp) != (size_t) n ||
+        fread(pg->view.Lx, sizeof(complex double), nnzL, F->fp) !=
+        (size_t) nnzL) {
+      printf("zldl: failed to read the factors of an out-of-core pole\n");
+      pg->cur = NULL;
+      return NULL;
+    }
+    pg->cur = F;
+  }
+  return &pg->view;
+}
+
+/* w = (L D L^T) \ w, in place */
+static void zldl_solve_perm(zldlFact *F, complex double *w) {
+  zldlSym *S = F->S;
+  int *Lp = S->Lp, *Li = S->Li, j, p, n = S->n;
+  complex double *Lx = F->Lx;
+  /*-------------------- w = L \ w */
+  for (j=0; j<n; j++) {
+    complex double wj = w[j];
+    for (p=Lp[j]; p<Lp[j+1]; p++) {
+      w[Li[p]] -= Lx[p] * wj;
+    }
+  }
+  /*-------------------- w = D \ w */
+  for (j=0; j<n; j++) {
+    w[j] /= F->D[j];
+  }
+  /*-------------------- w = L^T \ w */
+  for (j=n-1; j>=0; j--) {
+    complex double wj = w[j];
+    for (p=Lp[j]; p<Lp[j+1]; p++) {
+      wj -= Lx[p] * w[Li[p]];
+    }
+    w[j] = wj;
+  }
+}
+
+/* x = (A - z_k I) \ b [zldl_solvefunc]. Returns 1 if the factors cannot
+ * be read */
+static int zldl_solve(int n, double *br, double *bz, double *xr, double *xz,
+                      zldlData *H) {
+  zldlFact *F = zldl_fact(H);
+  int *perm, i, j;
+  complex double *w = H->w;
+  if (!F) {
+    return 1;
+  }
+  perm = F->S->perm;
+  /*-------------------- w = P * b */
+  for (i=0; i<n; i++) {
+    j = perm[i];
+    w[i] = br[j] + bz[j] * I;
+  }
+  zldl_solve_perm(F, w);
+  /*-------------------- x = P' * w */
+  for (i=0; i<n; i++) {
+    j = perm[i];
+    xr[j] = creal(w[i]);
+    xz[j] = cimag(w[i]);
+  }
+  return 0;
+}
+
+/* x = (A - z_k I) \ b [zldl_solvefunc_z] */
+static int zldl_solve_z(int n, complex double *b, complex double *x,
+                        zldlData *H) {
+  zldlFact *F = zldl_fact(H);
+  int *perm, i;
+  complex double *w = H->w;
+  if (!F) {
+    return 1;
+  }
+  perm = F->S->perm;
+  for (i=0; i<n; i++) {
+    w[i] = b[perm[i]];
+  }
+  zldl_solve_perm(F, w);
+  for (i=0; i<n; i++) {
+    x[perm[i]] = w[i];
+  }
+  return 0;
+}
+
+/* X = (A - z_k I) \ B, interleaved [zldl_solvefunc_block] */
+static int zldl_solve_block(int n, int nrhs, double *br, double *bz,
+                            double *xr, double *xz, zldlData *H) {
+  zldlFact *F = zldl_fact(H);
+  zldlSym *S;
+  int *Lp, *Li, i, j, p, r;
+  complex double *Lx, *w;
+  if (!F) {
+    return 1;
+  }
+  S = F->S;
+  Lp = S->Lp;
+  Li = S->Li;
+  Lx = F->Lx;
+  /*-------------------- grow the work space if needed */
+  if (nrhs > H->nw) {
+    Realloc(H->w, n*nrhs, complex double);
+    H->nw = nrhs;
+  }
+  w = H->w;
+  /*-------------------- W = P * B */
+  for (i=0; i<n; i++) {
+    j = S->perm[i];
+    for (r=0; r<nrhs; r++) {
+      w[i*nrhs+r] = br[r*n+j] + bz[r*n+j] * I;
+    }
+  }
+  /*-------------------- W = L \ W */
+  for (j=0; j<n; j++) {
+    complex double *wj = w + j*nrhs;
+    for (p=Lp[j]; p<Lp[j+1]; p++) {
+      complex double l = Lx[p], *wi = w + Li[p]*nrhs;
+      for (r=0; r<nrhs; r++) {
+        wi[r] -= l * wj[r];
+      }
+    }
+  }
+  /*-------------------- W = D \ W */
+  for (j=0; j<n; j++) {
+    complex double dj = 1.0 / F->D[j];
+    for (r=0; r<nrhs; r++) {
+      w[j*nrhs+r] *= dj;
+    }
+  }
+  /*-------------------- W = L^T \ W */
+  for (j=n-1; j>=0; j--) {
+    complex double *wj = w + j*nrhs;
+    for (p=Lp[j]; p<Lp[j+1]; p++) {
+      complex double l = Lx[p], *wi = w + Li[p]*nrhs;
+      for (r=0; r<nrhs; r++) {
+        wj[r] -= l * wi[r];
+      }
+    }
+  }
+  /*-------------------- X = P' * W */
+  for (i=0; i<n; i++) {
+    j = S->perm[i];
+    for (r=0; r<nrhs; r++) {
+      xr[r*n+j] = creal(w[i*nrhs+r]);
+      xz[r*n+j] = cimag(w[i*nrhs+r]);
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Complex linear solver routine passed to evsl [linSolFunc]:
+ * solves (A - z_k I) x = b with the LDL^T factors of the pole.
+ * The out-of-core poles of a filter share one page buffer, so their
+ * solves [reading the factors and solving with them] are done one at a
+ * time when the poles are processed in parallel [RatFiltApply]. The
+ * in-core poles are not serialized. If the factors of an out-of-core
+ * pole cannot be read back, x is set to NaN
+ */
+void zldl_solvefunc(int n, double *br, double *bz, double *xr, double *xz,
+                    void *data) {
+  zldlData *H = (zldlData *) data;
+  int i, err;
+  if (H->F->fp) {
+#ifdef _OPENMP
+#pragma omp critical (zldl_page)
+#endif
+    err = zldl_solve(n, br, bz, xr, xz, H);
+  } else {
+    err = zldl_solve(n, br, bz, xr, xz, H);
+  }
+  for (i=0; err && i<n; i++) {
+    xr[i] = xz[i] = NAN;
+  }
+}
+
+/**
+ * @brief Same as zldl_solvefunc with interleaved complex vectors
+ * [linSolFuncZ]
+ */
+void zldl_solvefunc_z(int n, complex double *b, complex double *x,
+                      void *data) {
+  zldlData *H = (zldlData *) data;
+  int i, err;
+  if (H->F->fp) {
+#ifdef _OPENMP
+#pragma omp critical (zldl_page)
+#endif
+    err = zldl_solve_z(n, b, x, H);
+  } else {
+    err = zldl_solve_z(n, b, x, H);
+  }
+  for (i=0; err && i<n; i++) {
+    x[i] = NAN;
+  }
+}
+
+/**
+ * @brief Multiple right-hand side version of zldl_solvefunc
+ * [linSolFuncBlock]: solves (A - z_k I) X = B for the nrhs columns of B
+ * at once. The right-hand sides are interleaved in the work array
+ * (row i of X is contiguous), so each entry of L is loaded once for
+ * all of them
+ */
+void zldl_solvefunc_block(int n, int nrhs, double *br, double *bz,
+                          double *xr, double *xz, void *data) {
+  zldlData *H = (zldlData *) data;
+  int i, err;
+  if (H->F->fp) {
+#ifdef _OPENMP
+#pragma omp critical (zldl_page)
+#endif
+    err = zldl_solve_block(n, nrhs, br, bz, xr, xz, H);
+  } else {
+    err = zldl_solve_block(n, nrhs, br, bz, xr, xz, H);
+  }
+  for (i=0; err && i<n*nrhs; i++) {
+    xr[i] = xz[i] = NAN;
+  }
+}
+
+/*-------------------- the factorization cache */
+static struct {
+  size_t budget;        // memory budget for the numeric factors (0: off)
+  char *dir;            // directory of the factor files (NULL: no files)
+  size_t bytes;         // memory used by the cached numeric factors
+  unsigned long clock;  // time stamp of the last use
+  zldlSym *syms;
+  zldlFact *facts;
+} zcache = {0, NULL, 0, 0, NULL, NULL};
+
+#define ZLDL_FNV_INIT 14695981039346656037ULL
+#define ZLDL_SYM_MAGIC "EVSLLDLS"
+#define ZLDL_FAC_MAGIC "EVSLLDLF"
+
+/* 64-bit FNV-1a hash of len bytes */
+static unsigned long long zldl_hash(unsigned long long h, const void *buf,
+                                    size_t len) {
+  const unsigned char *c = (const unsigned char *) buf;
+  size_t i;
+  for (i=0; i<len; i++) {
+    h ^= c[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/* key of a matrix: hash of its size, pattern and values */
+static unsigned long long zldl_matkey(csrMat *A) {
+  int n = A->nrows, nnz = A->ia[n];
+  unsigned long long h = ZLDL_FNV_INIT;
+  h = zldl_hash(h, &n, sizeof(int));
+  h = zldl_hash(h, A->ia, (n+1)*sizeof(int));
+  h = zldl_hash(h, A->ja, nnz*sizeof(int));
+  h = zldl_hash(h, A->a, nnz*sizeof(double));
+  return h;
+}
+
+/* key of the ordering of S, checked when the factors are read back */
+static unsigned long long zldl_permkey(zldlSym *S) {
+  return zldl_hash(ZLDL_FNV_INIT, S->perm, S->n*sizeof(int));
+}
+
+/* file name of the symbolic factors [F == NULL] or of the factors F */
+static char *zldl_filename(unsigned long long mkey, zldlFact *F) {
+  size_t len = strlen(zcache.dir) + 64;
+  char *fn;
+  Malloc(fn, len, char);
+  if (F) {
+    snprintf(fn, len, "%s/evsl_ldl_%016llx_%016llx.fac", zcache.dir, mkey,
+             zldl_hash(ZLDL_FNV_INIT, &F->zk, sizeof(complex double)));
+  } else {
+    snprintf(fn, len, "%s/evsl_ldl_%016llx.sym", zcache.dir, mkey);
+  }
+  return fn;
+}
+
+static void zldl_free_sym(zldlSym *S) {
+  free(S->perm);
+  free(S->iperm);
+  free(S->parent);
+  free(S->Lp);
+  free(S->Li);
+  free(S);
+}
+
+/* new (empty) numeric factors for the shift zk. Lx and D are not
+ * allocated if the factors are to be out of core [incore == 0] */
+static zldlFact *zldl_new_fact(zldlSym *S, complex double zk, int incore) {
+  zldlFact *F;
+  Malloc(F, 1, zldlFact);
+  F->S = S;
+  F->Lx = NULL;
+  F->D = NULL;
+  if (incore) {
+    Malloc(F->Lx, S->Lp[S->n], complex double);
+    Malloc(F->D, S->n, complex double);
+  }
+  F->zk = zk;
+  F->refs = 0;
+  F->cached = 0;
+  F->bytes = (S->Lp[S->n] + S->n) * sizeof(complex double);
+  F->stamp = 0;
+  F->fp = NULL;
+  F->next = NULL;
+  S->nref++;
+  return F;
+}
+
+/* free F, and S when no factors use it any more */
+static void zldl_free_fact(zldlFact *F) {
+  zldlSym *S = F->S, **pp;
+  free(F->Lx);
+  free(F->D);
+  if (F->fp) {
+    fclose(F->fp);
+  }
+  free(F);
+  if (--S->nref > 0) {
+    return;
+  }
+  if (S->cached) {
+    for (pp = &zcache.syms; *pp; pp = &(*pp)->next) {
+      if (*pp == S) {
+        *pp = S->next;
+        break;
+      }
+    }
+  }
+  zldl_free_sym(S);
+}
+
+/* drop the least recently used factors that are not in use until the
+ * cache fits in budget */
+static void zcache_evict(size_t budget) {
+  while (zcache.bytes > budget) {
+    zldlFact *F, *lru = NULL, **pp, **plru = NULL;
+    for (pp = &zcache.facts; (F = *pp); pp = &F->next) {
+      if (F->refs == 0 && (!lru || F->stamp < lru->stamp)) {
+        lru = F;
+        plru = pp;
+      }
+    }
+    if (!lru) {
+      /*-------------------- all the factors are in use */
+      break;
+    }
+    *plru = lru->next;
+    zcache.bytes -= lru->bytes;
+    zldl_free_fact(lru);
+  }
+}
+
+static void zcache_insert(zldlFact *F) {
+  F->cached = 1;
+  F->next = zcache.facts;
+  zcache.facts = F;
+  zcache.bytes += F->bytes;
+}
+
+static zldlFact *zcache_find(zldlSym *S, complex double zk) {
+  zldlFact *F;
+  for (F = zcache.facts; F; F = F->next) {
+    if (F->S == S && F->zk == zk) {
+      return F;
+    }
+  }
+  return NULL;
+}
+
+/* write S (with the pattern of L) to the cache directory */
+static void zldl_save_sym(zldlSym *S) {
+  char *fn = zldl_filename(S->mkey, NULL);
+  FILE *fp = fopen(fn, "wb");
+  int n = S->n, hdr[2];
+  if (fp) {
+    hdr[0] = n;
+    hdr[1] = S->Lp[n];
+    fwrite(ZLDL_SYM_MAGIC, 1, 8, fp);
+    fwrite(hdr, sizeof(int), 2, fp);
+    fwrite(&S->mkey, sizeof(unsigned long long), 1, fp);
+    fwrite(S->perm, sizeof(int), n, fp);
+    fwrite(S->parent, sizeof(int), n, fp);
+    fwrite(S->Lp, sizeof(int), n+1, fp);
+    fwrite(S->Li, sizeof(int), S->Lp[n], fp);
+    fclose(fp);
+  }
+  free(fn);
+}
+
+/* read the symbolic factors of the matrix of key mkey, NULL if there is
+ * no (valid) file */
+static zldlSym *zldl_load_sym(unsigned long long mkey, int n) {
+  char *fn = zldl_filename(mkey, NULL), magic[8];
+  FILE *fp = fopen(fn, "rb");
+  int k, hdr[2], ok;
+  unsigned long long key;
+  zldlSym *S;
+  free(fn);
+  if (!fp) {
+    return NULL;
+  }
+  ok = fread(magic, 1, 8, fp) == 8 && !memcmp(magic, ZLDL_SYM_MAGIC, 8) &&
+       fread(hdr, sizeof(int), 2, fp) == 2 &&
+       fread(&key, sizeof(unsigned long long), 1, fp) == 1 &&
+       hdr[0] == n && key == mkey;
+  if (!ok) {
+    fclose(fp);
+    return NULL;
+  }
+  Malloc(S, 1, zldlSym);
+  S->n = n;
+  Malloc(S->perm, n, int);
+  Malloc(S->iperm, n, int);
+  Malloc(S->parent, n, int);
+  Malloc(S->Lp, n+1, int);
+  Malloc(S->Li, hdr[1], int);
+  ok = fread(S->perm, sizeof(int), n, fp) == (size_t) n &&
+       fread(S->parent, sizeof(int), n, fp) == (size_t) n &&
+       fread(S->Lp, sizeof(int), n+1, fp) == (size_t) (n+1) &&
+       fread(S->Li, sizeof(int), hdr[1], fp) == (size_t) hdr[1] &&
+       S->Lp[n] == hdr[1];
+  fclose(fp);
+  if (!ok) {
+    zldl_free_sym(S);
+    return NULL;
+  }
+  for (k=0; k<n; k++) {
+    S->iperm[S->perm[k]] = k;
+  }
+  S->haveLi = 1;
+  S->nref = 0;
+  S->cached = 0;
+  S->mkey = mkey;
+  S->next = NULL;
+  return S;
+}
+
+/* write the numeric factors F to the cache directory */
+static void zldl_save_fact(zldlFact *F) {
+  zldlSym *S = F->S;
+  char *fn = zldl_filename(S->mkey, F);
+  FILE *fp = fopen(fn, "wb");
+  int hdr[2];
+  unsigned long long keys[2];
+  if (fp) {
+    hdr[0] = S->n;
+    hdr[1] = S->Lp[S->n];
+    keys[0] = S->mkey;
+    keys[1] = zldl_permkey(S);
+    fwrite(ZLDL_FAC_MAGIC, 1, 8, fp);
+    fwrite(hdr, sizeof(int), 2, fp);
+    fwrite(keys, sizeof(unsigned long long), 2, fp);
+    fwrite(&F->zk, sizeof(complex double), 1, fp);
+    fwrite(F->D, sizeof(complex double), hdr[0], fp);
+    fwrite(F->Lx, sizeof(complex double), hdr[1], fp);
+    fclose(fp);
+  }
+  free(fn);
+}
+
+/* read the numeric factors of F [shift F->zk] from the cache directory
+ * into F->D and F->Lx. Returns 0 on success, 1 if there is no (valid)
+ * file */
+static int zldl_read_fact(zldlFact *F) {
+  zldlSym *S = F->S;
+  char *fn = zldl_filename(S->mkey, F), magic[8];
+  FILE *fp = fopen(fn, "rb");
+  int hdr[2], ok = 0;
+  unsigned long long keys[2];
+  complex double z;
+  free(fn);
+  if (fp) {
+    ok = fread(magic, 1, 8, fp) == 8 && !memcmp(magic, ZLDL_FAC_MAGIC, 8) &&
+         fread(hdr, sizeof(int), 2, fp) == 2 &&
+         fread(keys, sizeof(unsigned long long), 2, fp) == 2 &&
+         fread(&z, sizeof(complex double), 1, fp) == 1 &&
+         hdr[0] == S->n && hdr[1] == S->Lp[S->n] && z == F->zk &&
+         keys[0] == S->mkey && keys[1] == zldl_permkey(S) &&
+         fread(F->D, sizeof(complex double), hdr[0], fp) == (size_t) hdr[0] &&
+         fread(F->Lx, sizeof(complex double), hdr[1], fp) == (size_t) hdr[1];
+    fclose(fp);
+  }
+  return !ok;
+}
+
+/* read the numeric factors of shift zk for S, NULL if there is no (valid)
+ * file */
+static zldlFact *zldl_load_fact(zldlSym *S, complex double zk) {
+  zldlFact *F = zldl_new_fact(S, zk, 1);
+  if (zldl_read_fact(F)) {
+    /*-------------------- S is in use: do not free it with F */
+    S->nref--;
+    free(F->Lx);
+    free(F->D);
+    free(F);
+    return NULL;
+  }
+  return F;
+}
+
+/* move the factors of F out of core, to a temporary file (deleted when
+ * it is closed). The caller owns F->Lx and F->D */
+static int zldl_page_out(zldlFact *F) {
+  int n = F->S->n, nnzL = F->S->Lp[n];
+  FILE *fp = tmpfile();
+  if (!fp) {
+    return 1;
+  }
+  if (fwrite(F->D, sizeof(complex double), n, fp) != (size_t) n ||
+      fwrite(F->Lx, sizeof(complex double), nnzL, fp) != (size_t) nnzL) {
+    fclose(fp);
+    return 1;
+  }
+  F->fp = fp;
+  F->Lx = NULL;
+  F->D = NULL;
+  return 0;
+}
+
+/**
+ * @brief Set the cache of the LDL^T factorizations of the poles
+ * @param budget  memory budget in bytes of the cached numeric factors.
+ *                0 turns the cache off and frees it
+ * @param dir     directory where the factors are saved and looked for
+ *                (so they are reused across runs), or NULL
+ * @warning The factors in use by a filter are not counted against the
+ * budget until the filter is freed. Only exact (matrix, shift) matches
+ * are reused
+ */
+void SetFactCache(size_t budget, const char *dir) {
+  if (budget == 0) {
+    FreeFactCache();
+    return;
+  }
+  free(zcache.dir);
+  zcache.dir = NULL;
+  if (dir) {
+    Malloc(zcache.dir, strlen(dir)+1, char);
+    strcpy(zcache.dir, dir);
+  }
+  zcache.budget = budget;
+  zcache_evict(budget);
+}
+
+/**
+ * @brief Free the factorization cache and turn it off. The factors
+ * still in use are freed with their filters
+ */
+void FreeFactCache() {
+  zldlFact *F, *Fnext;
+  zldlSym *S, *Snext;
+  zcache_evict(0);
+  for (F = zcache.facts; F; F = Fnext) {
+    Fnext = F->next;
+    F->cached = 0;
+    F->next = NULL;
+  }
+  for (S = zcache.syms; S; S = Snext) {
+    Snext = S->next;
+    S->cached = 0;
+    S->next = NULL;
+    if (S->nref == 0) {
+      zldl_free_sym(S);
+    }
+  }
+  zcache.facts = NULL;
+  zcache.syms = NULL;
+  zcache.bytes = 0;
+  zcache.budget = 0;
+  free(zcache.dir);
+  zcache.dir = NULL;
+}
+
+/**
+ * @brief Set the built-in complex symmetric LDL^T solver for all the poles
+ * of the rational filter. The symbolic factorization is done once and
+ * the numeric factorizations of the poles are done in parallel. With the
+ * factorization cache on, the factors are first looked for in the cache
+ * and in the cache directory, and the new ones are added to them.
+ *
+ * With a memory budget [rat->membudget > 0], the size of the factors is
+ * known after the symbolic factorization and the plan is chosen from it:
+ * all the factors in core, or as many as fit in core and the others out
+ * of core (factored one at a time and read back when they are needed), or
+ * the iterative solver COCG if not even one pole fits. The plan is
+ * printed and returned in rat->memplan
+ * @warning A must be symmetric with a symmetric pattern (both triangles
+ * stored)
+ */
+int set_ratf_solfunc_ldl(csrMat *A, ratparams *rat) {
+  int i, j, k, n, nnzL, num, nnew, nall, ncore, nres, first = 0, err = 0;
+  int newsym = 0;
+  int usecache = zcache.budget > 0, *stat, *inew;
+  unsigned long long mkey = 0;
+  size_t fbytes, sbytes, avail, m;
+  zldlSym *S = NULL;
+  zldlFact **F;
+  zldlPage *pg = NULL;
+
+  n = A->nrows;
+  num = rat->num;
+  /*-------------------- symbolic factorization */
+  if (usecache) {
+    mkey = zldl_matkey(A);
+    for (S = zcache.syms; S && (S->mkey != mkey || S->n != n); S = S->next);
+    if (!S && zcache.dir) {
+      S = zldl_load_sym(mkey, n);
+    }
+  }
+  if (!S) {
+    S = zldl_symbolic(A);
+    newsym = 1;
+  }
+  nnzL = S->Lp[n];
+  /*-------------------- memory plan: nres poles in core */
+  fbytes = (nnzL + n) * sizeof(complex double);
+  sbytes = (4*n + 1 + nnzL) * sizeof(int);
+  rat->factbytes = fbytes;
+  rat->memplan = 0;
+  nres = num;
+  if (rat->membudget > 0) {
+    avail = rat->membudget > sbytes ? rat->membudget - sbytes : 0;
+    m = avail / fbytes;
+    if (m == 0) {
+      printf("rational filter memory plan: the factors of one pole (%.1f MB)"
+             " exceed the budget (%.1f MB), using COCG\n",
+             (fbytes + sbytes) / 1048576.0, rat->membudget / 1048576.0);
+      if (!S->cached) {
+        zldl_free_sym(S);
+      }
+      rat->memplan = 2;
+      rat->nincore = 0;
+      return set_ratf_solfunc_iter(rat, A, NULL, NULL);
+    }
+    if (m < (size_t) num) {
+      /*-------------------- one buffer for the out-of-core poles */
+      nres = (int) m - 1;
+      rat->memplan = 1;
+    }
+  }
+  if (usecache && !S->cached) {
+    S->mkey = mkey;
+    S->cached = 1;
+    S->next = zcache.syms;
+    zcache.syms = S;
+  }
+  /*-------------------- numeric factors found in the cache or on disk.
+   *                     The ones on disk are read in core only within the
+   *                     memory plan [the others go to the buffer] */
+  Malloc(F, num, zldlFact *);
+  Malloc(stat, num, int);
+  Malloc(inew, num, int);
+  ncore = 0;
+  for (i=0; i<num; i++) {
+    F[i] = NULL;
+    stat[i] = 0;
+    if (usecache) {
+      F[i] = zcache_find(S, rat->zk[i]);
+      if (!F[i] && zcache.dir && S->haveLi && ncore < nres) {
+        F[i] = zldl_load_fact(S, rat->zk[i]);
+        if (F[i]) {
+          zcache_insert(F[i]);
+        }
+      }
+    }
+    if (F[i]) {
+      ncore++;
+    }
+  }
+  /*-------------------- new factors: in core first, then out of core */
+  nnew = 0;
+  for (i=0; i<num; i++) {
+    if (!F[i] && ncore < nres) {
+      F[i] = zldl_new_fact(S, rat->zk[i], 1);
+      inew[nnew++] = i;
+      ncore++;
+    }
+  }
+  nall = nnew;
+  for (i=0; i<num; i++) {
+    if (!F[i]) {
+      F[i] = zldl_new_fact(S, rat->zk[i], 0);
+      inew[nall++] = i;
+    }
+  }
+  /*-------------------- the first factorization also stores the pattern
+   *                     of L. If it fails, S->Li is not set and the other
+   *                     poles are skipped [stat = -1] */
+  if (nnew > 0 && !S->haveLi) {
+    i = inew[0];
+    stat[i] = zldl_numeric(A, S, rat->zk[i], 1, F[i]);
+    S->haveLi = !stat[i];
+    first = S->haveLi ? 1 : nnew;
+    for (j=1; j<nall && !S->haveLi; j++) {
+      stat[inew[j]] = -1;
+    }
+  }
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic)
+#endif
+  for (j=first; j<nnew; j++) {
+    i = inew[j];
+    stat[i] = zldl_numeric(A, S, rat->zk[i], 0, F[i]);
+  }
+  /*-------------------- out-of-core poles, one at a time in the buffer */
+  if (ncore < num) {
+    Malloc(pg, 1, zldlPage);
+    pg->view.S = S;
+    Malloc(pg->view.Lx, nnzL, complex double);
+    Malloc(pg->view.D, n, complex double);
+    pg->cur = NULL;
+    for (j=nnew; j<nall; j++) {
+      i = inew[j];
+      if (stat[i]) {
+        /*-------------------- skipped: no factors */
+        continue;
+      }
+      F[i]->Lx = pg->view.Lx;
+      F[i]->D = pg->view.D;
+      /*-------------------- read from the cache directory, or factor */
+      if (!(usecache && zcache.dir && S->haveLi && !zldl_read_fact(F[i]))) {
+        stat[i] = zldl_numeric(A, S, rat->zk[i], !S->haveLi, F[i]);
+        if (!S->haveLi) {
+          S->haveLi = !stat[i];
+          for (k=j+1; k<nall && !S->haveLi; k++) {
+            stat[inew[k]] = -1;
+          }
+        }
+        if (usecache && zcache.dir && !stat[i]) {
+          zldl_save_fact(F[i]);
+        }
+      }
+      if (zldl_page_out(F[i])) {
+        printf("zldl: failed to write the factors of pole %d, kept in core\n",
+               i);
+        Malloc(F[i]->Lx, nnzL, complex double);
+        Malloc(F[i]->D, n, complex double);
+        memcpy(F[i]->Lx, pg->view.Lx, nnzL*sizeof(complex double));
+        memcpy(F[i]->D, pg->view.D, n*sizeof(complex double));
+        ncore++;
+      } else {
+        pg->cur = F[i];
+      }
+    }
+  }
+  if (usecache && zcache.dir && newsym && S->haveLi) {
+    zldl_save_sym(S);
+  }
+  for (i=0; i<num; i++) {
+    if (stat[i] > 0) {
+      printf("zldl_numeric failed: zero pivot %d for pole %d\n", stat[i], i);
+    }
+    err = err || stat[i];
+  }
+  /*-------------------- only the new factors in core go to the cache */
+  for (j=0; j<nnew && usecache; j++) {
+    i = inew[j];
+    if (!stat[i]) {
+      zcache_insert(F[i]);
+      if (zcache.dir) {
+        zldl_save_fact(F[i]);
+      }
+    }
+  }
+  rat->nincore = ncore;
+  if (rat->membudget > 0) {
+    printf("rational filter memory plan: %d poles of %.1f MB, budget %.1f MB"
+           ": %d in core, %d out of core\n", num, fbytes / 1048576.0,
+           rat->membudget / 1048576.0, ncore, num - ncore);
+  }
+  for (i=0; i<num; i++) {
+    zldlData *H;
+    Malloc(H, 1, zldlData);
+    H->F = F[i];
+    H->page = pg;
+    Malloc(H->w, n, complex double);
+    H->nw = 1;
+    F[i]->refs++;
+    F[i]->stamp = ++zcache.clock;
+    rat->solshift[i] = zldl_solvefunc;
+    rat->solshiftblk[i] = zldl_solvefunc_block;
+    rat->solshiftz[i] = zldl_solvefunc_z;
+    rat->solshiftdata[i] = H;
+  }
+  zcache_evict(zcache.budget);
+  free(F);
+  free(stat);
+  free(inew);
+
+  return err;
+}
+
+/**
+ * @brief Free the LDL^T solver data of the poles set by
+ * set_ratf_solfunc_ldl. The factors that are not cached are freed, and
+ * the files of the out-of-core ones are deleted
+ */
+void free_rat_ldl_sol(ratparams *rat) {
+  int i;
+  zldlPage *pg = NULL;
+  for (i=0; i<rat->num; i++) {
+    zldlData *H = (zldlData *) rat->solshiftdata[i];
+    zldlFact *F = H->F;
+    pg = H->page;
+    free(H->w);
+    free(H);
+    if (--F->refs == 0 && !F->cached) {
+      zldl_free_fact(F);
+    }
+  }
+  /*-------------------- the buffer of the out-of-core poles */
+  if (pg) {
+    free(pg->view.Lx);
+    free(pg->view.D);
+    free(pg);
+  }
+  /*-------------------- the factors released may exceed the budget */
+  zcache_evict(zcache.budget);
+}
@@ -53,7 +53,7 @@ int main(int argc, char *argv[]) {
   /* user input from command line */
   flg = findarg("help", NA, NULL, argc, argv);
   if (flg) {
-    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int]\n");
+    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int] -polcache [str]\n");
     return 0;
   }
   findarg("nx", INT, &nx, argc, argv);
@@ -62,6 +62,11 @@ int main(int argc, char *argv[]) {
   findarg("a", DOUBLE, &a, argc, argv);
   findarg("b", DOUBLE, &b, argc, argv);
   findarg("nslices", INT, &nslices, argc, argv);
+  /*-------------------- cache of the filters, saved in the file if given */
+  char polcache[256] = "";
+  if (findarg("polcache", STR, polcache, argc, argv)) {
+    SetPolCache(polcache);
+  }
   fprintf(fstats,"used nx = %3d ny = %3d nz = %3d",nx,ny,nz);
   fprintf(fstats," [a = %4.2f  b= %4.2f],  nslices=%2d \n",a,b,nslices);
   //-------------------- eigenvalue bounds set by hand.
@@ -212,6 +217,8 @@ int main(int argc, char *argv[]) {
   free_csr(&Acsr);
   free(mu);
   fclose(fstats);
+  /*-------------------- save the filters [if -polcache] */
+  FreePolCache();
 
   return 0;
 }
@@ -16,6 +16,9 @@ int exeiglap3(int nx, int ny, int nz, double a, double b, int *m, double **vo);
  * The matvec routine and the associated data will need to be registered */
 /* matvec routine [it must be of this prototype] */
 void Lap2D3DMatvec(double *x, double *y, void *data);
+/* [optional] matvec routine fused with the steps of the filter */
+void Lap2D3DChebStep(double alpha, double cc, double beta, double *vk,
+                     double *vkm1, double *vkp1, double *y, void *data);
 /* datatype for performing matvec for Laplacians */
 typedef struct _lapmv_t {
   int nx, ny, nz;
@@ -95,6 +98,9 @@ int main(int argc, char *argv[]) {
   /*-------------------- without forming the matrix, 
    *                     just setup the matvec function and data */
   SetMatvecFunc(n, &Lap2D3DMatvec, (void*) &lapmv);
+  /*-------------------- the filter can do its steps with the stencil in
+   *                     one pass [optional] */
+  SetMatvecChebFunc(&Lap2D3DChebStep);
   /*-------------------- step 0: get eigenvalue bounds */
   fprintf(fstats, "Step 0: Eigenvalue bound s for A: [%.15e, %.15e]\n", lmin, lmax);
   /*-------------------- call kpmdos to get the DOS for dividing the spectrum*/
@@ -258,3 +264,36 @@ void Lap2D3DMatvec(double *x, double *y, void *data) {
   }
 }
 
+/*----------------- [optional] the same, fused with one step of the filter
+ *                  vkp1 = alpha * (A*vk - cc*vk) - vkm1,  y += beta * vkp1 */
+void Lap2D3DChebStep(double alpha, double cc, double beta, double *vk,
+                     double *vkm1, double *vkp1, double *y, void *data) {
+  lapmv_t *lapmv = (lapmv_t *) data;
+  int nx = lapmv->nx;
+  int ny = lapmv->ny;
+  int nz = lapmv->nz;
+  double *stencil = lapmv->stencil;
+  int i,j,k,p;
+  double r;
+
+  for (k=0; k<nz; k++) {
+    for (j=0; j<ny; j++) {
+      for (i=0; i<nx; i++) {
+        p = k*nx*ny + j*nx + i;
+        r = (stencil[0] - cc) * vk[p];
+        // x-1, x+1
+        if (i>0)    { r += stencil[1] * vk[p-1]; }
+        if (i<nx-1) { r += stencil[2] * vk[p+1]; }
+        // y-1, y+1
+        if (j>0)    { r += stencil[3] * vk[p-nx]; }
+        if (j<ny-1) { r += stencil[4] * vk[p+nx]; }
+        // z-1, z+1
+        if (k>0)    { r += stencil[5] * vk[p-nx*ny]; }
+        if (k<nz-1) { r += stencil[6] * vk[p+nx*ny]; }
+        r = alpha * r - vkm1[p];
+        vkp1[p] = r;
+        y[p] += beta * r;
+      }
+    }
+  }
+}
@@ -27,7 +27,7 @@ int main(int argc, char *argv[]) {
     Thick-restart Lanczos with polynomial filtering
     ------------------------------------------------------------*/
   int n, nx, ny, nz, i, j, npts, nslices, nvec, Mdeg, nev, 
-      mlan, max_its, ev_int, sl, flg, ierr;
+      mlan, max_its, ev_int, sl, flg, ierr, sstep, pipe, damping, clen, tb;
   /* find the eigenvalues of A in the interval [a,b] */
   double a, b, lmax, lmin, ecount, tol,   *sli, *mu;
   double xintv[4];
@@ -48,12 +48,17 @@ int main(int argc, char *argv[]) {
   a    = 0.4;
   b    = 0.8;
   nslices = 4;
+  sstep = 1;
+  pipe = 0;
+  damping = 0;
+  clen = 0;
+  tb = 0;
   //-----------------------------------------------------------------------
   //-------------------- reset some default values from command line [Yuanzhe/]
   /* user input from command line */
   flg = findarg("help", NA, NULL, argc, argv);
   if (flg) {
-    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int]\n");
+    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int] -sstep [int] -pipe [int] -polcache [str] -damping [int] -clen [int] -tb [int]\n");
     return 0;
   }
   findarg("nx", INT, &nx, argc, argv);
@@ -62,6 +67,25 @@ int main(int argc, char *argv[]) {
   findarg("a", DOUBLE, &a, argc, argv);
   findarg("b", DOUBLE, &b, argc, argv);
   findarg("nslices", INT, &nslices, argc, argv);
+  /*-------------------- cache of the filters, saved in the file if given */
+  char polcache[256] = "";
+  if (findarg("polcache", STR, polcache, argc, argv)) {
+    SetPolCache(polcache);
+  }
+  findarg("sstep", INT, &sstep, argc, argv);
+  /*-------------------- block size of s-step Lanczos [1: standard] */
+  SetLanSstep(sstep);
+  findarg("pipe", INT, &pipe, argc, argv);
+  /*-------------------- merged reductions in Lanczos [0: standard] */
+  SetLanPipelined(pipe);
+  /*-------------------- damping of the filters [3: Dolph-Chebyshev] */
+  findarg("damping", INT, &damping, argc, argv);
+  findarg("clen", INT, &clen, argc, argv);
+  /*-------------------- filter by the Clenshaw recurrence [0: forward] */
+  SetChebClenshaw(clen);
+  findarg("tb", INT, &tb, argc, argv);
+  /*-------------------- temporal blocking of the filter [0: auto, -1: off] */
+  SetChebTBlock(tb);
   fprintf(fstats,"used nx = %3d ny = %3d nz = %3d",nx,ny,nz);
   fprintf(fstats," [a = %4.2f  b= %4.2f],  nslices=%2d \n",a,b,nslices);
   //-------------------- eigenvalue bounds set by hand.
@@ -145,7 +169,7 @@ int main(int argc, char *argv[]) {
     set_pol_def(&pol);
     //-------------------- this is to show how you can reset some of the
     //                     parameters to determine the filter polynomial
-    pol.damping = 0;
+    pol.damping = damping;
     //-------------------- use a stricter requirement for polynomial
     pol.thresh_int = 0.25;
     pol.thresh_ext = 0.15;
@@ -214,6 +238,8 @@ int main(int argc, char *argv[]) {
   free_csr(&Acsr);
   free(mu);
   fclose(fstats);
+  /*-------------------- save the filters [if -polcache] */
+  FreePolCache();
 
   return 0;
 }
@@ -33,7 +33,7 @@ int main(int argc, char *argv[]) {
   int n, nx, ny, nz, i, j, npts, nslices, nvec, Mdeg, nev, 
       mlan, max_its, ev_int, sl, flg, ierr;
   /* find the eigenvalues of A in the interval [a,b] */
-  double a, b, lmax, lmin, ecount, tol, *sli, *mu;
+  double a, b, lmax, lmin, ecount, tol, btol, *sli, *mu;
   double xintv[4];
   double *vinit;
   polparams pol;
@@ -52,12 +52,20 @@ int main(int argc, char *argv[]) {
   a    = 0.6;
   b    = 0.9;
   nslices = 4;
+#ifdef EVSL_WITH_SUITESPARSE
+  btol = 0.0;
+#else
+  /* no Cholesky factorization of B without SuiteSparse */
+  btol = 1e-10;
+#endif
   //-----------------------------------------------------------------------
   //-------------------- reset some default values from command line [Yuanzhe/]
   /* user input from command line */
   flg = findarg("help", NA, NULL, argc, argv);
   if (flg) {
-    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int]\n");
+    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int] -polB [double]\n");
+    printf("       -polB tol: no factorization of B, polynomial in B of accuracy tol\n");
+    printf("                  [the default without SuiteSparse, tol = 1e-10]\n");
     return 0;
   }
   findarg("nx", INT, &nx, argc, argv);
@@ -66,6 +74,7 @@ int main(int argc, char *argv[]) {
   findarg("a", DOUBLE, &a, argc, argv);
   findarg("b", DOUBLE, &b, argc, argv);
   findarg("nslices", INT, &nslices, argc, argv);
+  findarg("polB", DOUBLE, &btol, argc, argv);
   fprintf(fstats,"used nx = %3d ny = %3d nz = %3d",nx,ny,nz);
   fprintf(fstats," [a = %4.2f  b= %4.2f],  nslices=%2d \n",a,b,nslices);
   /*-------------------- matrix size */
@@ -87,7 +96,20 @@ int main(int argc, char *argv[]) {
   /*-------------------- start EVSL */
   EVSLStart();
   /*-------------------- set the right-hand side matrix B */
-  SetRhsMatrix(&Bcsr);
+  if (btol > 0.0) {
+    ierr = SetRhsMatrixPol(&Bcsr, btol);
+  } else {
+#ifdef EVSL_WITH_SUITESPARSE
+    ierr = SetRhsMatrix(&Bcsr);
+#else
+    printf("-polB tol > 0 is needed without SuiteSparse\n");
+    ierr = -1;
+#endif
+  }
+  if (ierr) {
+    printf("SetRhsMatrix error %d\n", ierr);
+    return 1;
+  }
   /*-------------------- step 0: get eigenvalue bounds */
   //-------------------- initial vector  
   vinit = (double *) malloc(n*sizeof(double));
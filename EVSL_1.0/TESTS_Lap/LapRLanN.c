@@ -29,7 +29,16 @@ int main(int argc, char *argv[]) {
     Non-restart Lanczos with rational filtering
     ------------------------------------------------------------*/
   int n, nx, ny, nz, i, j, npts, nslices, nvec, Mdeg, nev, 
-      max_its, ev_int, sl, flg, ierr;
+      max_its, ev_int, sl, flg, ierr, bs, solver;
+  /* LDL^T factorization cache: budget in MB [0: off] and directory */
+  int cachemb = 0;
+  char cachedir[256] = "";
+  /* memory budget in MB for the factors of the poles [0: no limit] */
+  int memmb = 0;
+  /* choose the number of poles and multiplicity [cost factor: see
+   * ratparams] */
+  int optpoles = 0;
+  double costfact = 20.0;
   /* find the eigenvalues of A in the interval [a,b] */
   double a, b, lmax, lmin, ecount, tol, *sli, *mu;
   double xintv[4];
@@ -54,12 +63,16 @@ int main(int argc, char *argv[]) {
   a    = 0.4;
   b    = 0.8;
   nslices = 4;
+  solver = 0;
+  bs   = 1;
   //-----------------------------------------------------------------------
   //-------------------- reset some default values from command line [Yuanzhe/]
   /* user input from command line */
   flg = findarg("help", NA, NULL, argc, argv);
   if (flg) {
-    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int]\n");
+    printf("Usage: ./testL.ex -nx [int] -ny [int] -nz [int] -a [double] -b [double] -nslices [int] -bs [int] -solver [int] -num [int] -pw [int] -cache [int] -cachedir [str] -mem [int] -optpoles -costfact [double]\n");
+    printf("  -solver: 1: UMFPACK [needs SuiteSparse], 2: LDL^T, 3: COCG,\n");
+    printf("           4: multi-shift COCG\n");
     return 0;
   }
   findarg("nx", INT, &nx, argc, argv);
@@ -68,6 +81,22 @@ int main(int argc, char *argv[]) {
   findarg("a", DOUBLE, &a, argc, argv);
   findarg("b", DOUBLE, &b, argc, argv);
   findarg("nslices", INT, &nslices, argc, argv);
+  /* shifted solver [RATF_SOLVER_*]: 1: UMFPACK, 2: LDL^T, 3: COCG,
+   * 4: multi-shift COCG [default: see set_ratf_def] */
+  findarg("solver", INT, &solver, argc, argv);
+  /* number of poles and their multiplicity */
+  findarg("num", INT, &num, argc, argv);
+  findarg("pw", INT, &pow, argc, argv);
+  findarg("cache", INT, &cachemb, argc, argv);
+  findarg("cachedir", STR, cachedir, argc, argv);
+  findarg("mem", INT, &memmb, argc, argv);
+  optpoles = findarg("optpoles", NA, NULL, argc, argv);
+  findarg("costfact", DOUBLE, &costfact, argc, argv);
+  if (cachemb > 0) {
+    SetFactCache((size_t) cachemb << 20, cachedir[0] ? cachedir : NULL);
+  }
+  /* block size: bs > 1 uses the block rational Lanczos */
+  findarg("bs", INT, &bs, argc, argv);
   fprintf(fstats,"used nx = %3d ny = %3d nz = %3d",nx,ny,nz);
   fprintf(fstats," [a = %4.2f  b= %4.2f],  nslices=%2d \n",a,b,nslices);
   //-------------------- eigenvalue bounds set by hand.
@@ -119,8 +148,8 @@ int main(int argc, char *argv[]) {
   //-------------------- # eigs per slice
   ev_int = (int) (1 + ecount / ((double) nslices));
   //-------------------- initial vector  
-  vinit = (double*) malloc(n*sizeof(double));
-  rand_double(n, vinit);
+  vinit = (double*) malloc(n*bs*sizeof(double));
+  rand_double(n*bs, vinit);
   //-------------------- For each slice call RatLanrNr
   for (sl=0; sl<nslices; sl++) {
     printf("======================================================\n");
@@ -146,17 +175,35 @@ int main(int argc, char *argv[]) {
     rat.pw = pow;
     rat.num = num;
     rat.beta = beta;
+    rat.membudget = (size_t) memmb << 20;
+    rat.optpoles = optpoles;
+    rat.costfact = costfact;
+    if (solver > 0) {
+      rat.defsolver = solver;
+    }
     // now determine rational filter
     find_ratf(intv, &rat);
-    // use the default solver function from UMFPACK
-    set_ratf_solfunc(&rat, &Acsr, NULL, NULL);
+    // use the default solver function (UMFPACK, or the built-in LDL^T)
+    t = cheblan_timer();
+    ierr = set_ratf_solfunc(&rat, &Acsr, NULL, NULL);
+    t = cheblan_timer() - t;
+    if (ierr) {
+      printf("set_ratf_solfunc error %d\n", ierr);
+      return 1;
+    }
+    printf(" solver setup time [factorizations]: %.2f\n", t);
     //-------------------- approximate number of eigenvalues wanted
     nev = ev_int+2;
     //-------------------- maximal Lanczos iterations   
     max_its = max(4*nev,100);  max_its = min(max_its, n);
     //-------------------- RationalLanNr
-    ierr = RatLanNr(&Acsr, intv, &rat, max_its, tol, vinit, &nev2, &lam, 
-                    &Y, &res, fstats);
+    if (bs > 1) {
+      ierr = RatLanNrBlock(&Acsr, intv, &rat, bs, max_its, tol, vinit, &nev2,
+                           &lam, &Y, &res, fstats);
+    } else {
+      ierr = RatLanNr(&Acsr, intv, &rat, max_its, tol, vinit, &nev2, &lam, 
+                      &Y, &res, fstats);
+    }
     if (ierr) {
       printf("RatLanNr error %d\n", ierr);
       return 1;
@@ -209,6 +256,7 @@ int main(int argc, char *argv[]) {
   free_coo(&Acoo);
   free_csr(&Acsr);
   free(mu);
+  FreeFactCache();
   fclose(fstats);
   
   return 0;